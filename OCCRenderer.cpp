@@ -1,4 +1,5 @@
-#include <iostream>
+#include <algorithm>
+#include <cmath>
 #ifdef _WIN32
 #include <windows.h>
 #endif
@@ -6,23 +7,29 @@
 #include <QApplication>
 #include <QMessageBox>
 #include <QMouseEvent>
+#include <QOpenGLContext>
 #include <QOpenGLExtraFunctions>
 #include <QOpenGLFunctions>
 #include <QQuickWindow>
 #include <QScreen>
-#include <QTime>
+#include <QTimer>
 
 #include <AIS_Shape.hxx>
 #include <AIS_ViewCube.hxx>
 #include <Aspect_DisplayConnection.hxx>
 #include <Aspect_NeutralWindow.hxx>
 #include <BRepPrimAPI_MakeBox.hxx>
+#include <Graphic3d_Camera.hxx>
+#include <Graphic3d_CView.hxx>
+#include <Graphic3d_FrameStats.hxx>
 #include <Message.hxx>
 #include <OpenGl_Context.hxx>
 #include <OpenGl_FrameBuffer.hxx>
 #include <OpenGl_GraphicDriver.hxx>
 
 #include "OCCRenderer.h"
+#include "OccLog.h"
+#include "OccTrace.h"
 #include "OccViewerItem.h"
 #include "OcctFrameBuffer.h"
 #include "OcctGlTools.h"
@@ -65,7 +72,8 @@ OCCRenderer::OCCRenderer(const OccViewerItem *item)
     view_->ChangeRenderingParams().CollectedStats =
         (Graphic3d_RenderingParams::
              PerfCounters)(Graphic3d_RenderingParams::PerfCounters_FrameRate |
-                           Graphic3d_RenderingParams::PerfCounters_Triangles);
+                           Graphic3d_RenderingParams::PerfCounters_Triangles |
+                           Graphic3d_RenderingParams::PerfCounters_Elements);
 
     view_->ChangeRenderingParams().NbMsaaSamples = 0;
     view_->ChangeRenderingParams().RenderResolutionScale = 1.0;
@@ -80,6 +88,13 @@ OCCRenderer::~OCCRenderer()
 {
     Handle(Aspect_DisplayConnection) aDisp = viewer_->Driver()->GetDisplayConnection();
 
+    // the GL context is current while Qt destroys the renderer
+    grabber_.release();
+    if (!grab_fbo_.IsNull())
+    {
+        view_->View()->FBORelease(grab_fbo_);
+    }
+
     // release OCCT viewer
     context_->RemoveAll(false);
     context_.Nullify();
@@ -97,65 +112,483 @@ OCCRenderer::~OCCRenderer()
 
 void OCCRenderer::synchronize(QQuickFramebufferObject *item)
 {
+    OCC_TRACE_SCOPE("render", "OCCRenderer::synchronize");
+    QElapsedTimer syncTimer;
+    syncTimer.start();
     scale_ = item->window()->devicePixelRatio();
+    // same rounding as QQuickFramebufferObject's FBO size
+    const QSize itemSize(std::max(int(item->width()), 1), std::max(int(item->height()), 1));
+    updateFramebufferSize(itemSize * item->window()->effectiveDevicePixelRatio());
+
+    // GUI thread is blocked here, apply all scene mutations in one batch
+    auto *viewer = static_cast<OccViewerItem *>(item);
+    // pointer input coalesced since the previous frame
+    if (!viewer->inputQueue().isEmpty())
+    {
+        input_changed_ = applyInput(viewer->inputQueue().take()) || input_changed_;
+    }
+    scene_manager_->setLodPixelError(viewer->lodPixelError());
+    resolution_.setSettings(viewer->resolutionSettings());
+    scene_manager_->beginUpdate();
+    if (viewer->commandQueue().drain(*this) > 0)
+    {
+        input_changed_ = true;
+    }
+    scene_manager_->endUpdate();
+
+    render_stats_ = viewer->renderStats();
+    frame_timings_.synchronize_ms = double(syncTimer.nsecsElapsed()) / 1.0e6;
 }
 
 void OCCRenderer::render()
 {
-    QString times = "[" + QTime::currentTime().toString("hh:mm:ss.zzz") + "]";
-    std::cout << times.toStdString() << " render" << std::endl;
-
+    OCC_TRACE_SCOPE("render", "OCCRenderer::render");
     if (view_->Window().IsNull())
     {
         return;
     }
 
+    QElapsedTimer renderTimer;
+    renderTimer.start();
+
     // wrap FBO created by QQuickFramebufferObject
     Handle(OpenGl_Context) aGlCtx = OcctGlTools::GetGlContext(view_);
     Handle(OpenGl_FrameBuffer) aDefaultFbo = aGlCtx->DefaultFrameBuffer();
     if (aDefaultFbo.IsNull())
     {
-        std::cout << "[OCCRenderer] Creating new framebuffer" << std::endl;
+        qCDebug(lcOccRender) << "Creating new framebuffer";
         aDefaultFbo = new OcctQtFrameBuffer();
         aGlCtx->SetDefaultFrameBuffer(aDefaultFbo);
     }
     if (!aDefaultFbo->InitWrapper(aGlCtx))
     {
-        std::cout << "[render] aDefaultFbo->InitWrapper(aGlCtx) failed" << std::endl;
+        qCWarning(lcOccRender) << "aDefaultFbo->InitWrapper(aGlCtx) failed";
         aDefaultFbo.Nullify();
         return;
     }
 
+    // the FBO is allocated in buckets, the view uses its lower left part
+    if (view_size_.isValid())
+    {
+        aDefaultFbo->ChangeViewport(view_size_.width(), view_size_.height());
+    }
     aDefaultFbo->SetupViewport(aGlCtx);
+    if (resizeView(aDefaultFbo->GetVPSize()))
+    {
+        aDefaultFbo->SetupViewport(aGlCtx);
+    }
+    frame_timings_.fbo_ms = double(renderTimer.nsecsElapsed()) / 1.0e6;
+
+    underlay_ = false;
+    renderScene(aGlCtx, aDefaultFbo,
+                QSize(aDefaultFbo->GetVPSizeX(), aDefaultFbo->GetVPSizeY()), renderTimer);
+}
+
+void OCCRenderer::renderUnderlay(const QSize &size)
+{
+    OCC_TRACE_SCOPE("render", "OCCRenderer::renderUnderlay");
+    if (size.isEmpty())
+    {
+        return;
+    }
+    if (view_->Window().IsNull())
+    {
+        qCDebug(lcOccRender) << "Initializing OpenGL context for underlay";
+        initializeGL(size);
+    }
+
+    QElapsedTimer renderTimer;
+    renderTimer.start();
+
+    // draw straight into the window's framebuffer, the render pass has been
+    // cleared already and the QML content is recorded on top. Without a
+    // default FBO OCCT targets framebuffer 0 on its own.
+    QOpenGLContext *qtContext = QOpenGLContext::currentContext();
+    const GLuint windowFbo = qtContext->defaultFramebufferObject();
+    Handle(OpenGl_Context) aGlCtx = OcctGlTools::GetGlContext(view_);
+    Handle(OpenGl_FrameBuffer) aWindowFbo;
+    if (windowFbo != 0)
+    {
+        aWindowFbo = aGlCtx->DefaultFrameBuffer();
+        if (aWindowFbo.IsNull())
+        {
+            aWindowFbo = new OcctQtFrameBuffer();
+        }
+        qtContext->functions()->glBindFramebuffer(GL_FRAMEBUFFER, windowFbo);
+        if (!aWindowFbo->InitWrapper(aGlCtx))
+        {
+            qCWarning(lcOccRender) << "Window framebuffer wrapping failed";
+            return;
+        }
+    }
+    aGlCtx->SetDefaultFrameBuffer(aWindowFbo);
+
+    const Graphic3d_Vec2i aViewSize(size.width(), size.height());
+    resizeView(aViewSize);
+    if (aWindowFbo.IsNull())
+    {
+        const Standard_Integer aViewport[4] = {0, 0, aViewSize.x(), aViewSize.y()};
+        aGlCtx->ResizeViewport(aViewport);
+    }
+    else
+    {
+        aWindowFbo->SetupViewport(aGlCtx);
+    }
+    frame_timings_.fbo_ms = double(renderTimer.nsecsElapsed()) / 1.0e6;
+
+    underlay_ = true;
+    renderScene(aGlCtx, aWindowFbo, size, renderTimer);
+
+    // Qt Quick batches opaque items with the depth buffer, leave it cleared
+    QOpenGLFunctions *gl = qtContext->functions();
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, windowFbo);
+    gl->glDisable(GL_SCISSOR_TEST);
+    gl->glDepthMask(GL_TRUE);
+    gl->glStencilMask(0xFF);
+    gl->glClearDepthf(1.0f);
+    gl->glClearStencil(0);
+    gl->glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
 
+bool OCCRenderer::resizeView(const Graphic3d_Vec2i &size)
+{
     Graphic3d_Vec2i aViewSizeOld;
-    Graphic3d_Vec2i aViewSizeNew = aDefaultFbo->GetVPSize();
     Handle(Aspect_NeutralWindow) aWindow = Handle(Aspect_NeutralWindow)::DownCast(view_->Window());
     aWindow->Size(aViewSizeOld.x(), aViewSizeOld.y());
-    if (aViewSizeNew != aViewSizeOld)
+    if (size == aViewSizeOld)
     {
-        aWindow->SetSize(aViewSizeNew.x(), aViewSizeNew.y());
-        view_->MustBeResized();
-        view_->Invalidate();
+        return false;
+    }
 
-        for (Handle(V3d_View) aSubviewIter : view_->Subviews())
-        {
-            aSubviewIter->MustBeResized();
-            aSubviewIter->Invalidate();
-            aDefaultFbo->SetupViewport(aGlCtx);
-        }
+    aWindow->SetSize(size.x(), size.y());
+    view_->MustBeResized();
+    view_->Invalidate();
+    for (Handle(V3d_View) aSubviewIter : view_->Subviews())
+    {
+        aSubviewIter->MustBeResized();
+        aSubviewIter->Invalidate();
     }
-    if (pending_fit_all_)
+    return true;
+}
+
+void OCCRenderer::renderScene(const Handle(OpenGl_Context) & glCtx,
+                              const Handle(OpenGl_FrameBuffer) & targetFbo, const QSize &size,
+                              const QElapsedTimer &renderTimer)
+{
+    // wait for shapes still meshed in background to get the full extent
+    if (pending_fit_all_ && !scene_manager_->hasPendingShapes())
     {
         view_->FitAll();
         view_->ZFitAll();
         pending_fit_all_ = false;
     }
 
+    // display shapes meshed in background, the rest waits for the next frame
+    if (scene_manager_->commitFinishedShapes(commit_budget_ms_))
+    {
+        requestUpdate();
+    }
+
+    // adapt the resolution to the time the previous redraw took. The time
+    // between frames would count vsync waits and idle gaps as well.
+    const bool interacting = isInteracting() && last_draw_ms_ > 0.0;
+    applyResolutionScale(resolution_.update(last_draw_ms_, interacting));
+
+    // a new Qt FBO has no content yet, otherwise only dirty layers are drawn
+    if (fbo_recreated_)
+    {
+        view_->Invalidate();
+        fbo_recreated_ = false;
+    }
+
+    // hand over grabs whose readback finished since the previous frame
+    grabber_.poll();
+
     // Only display viewcube once during initialization, not every frame
     // context_->Display(view_cube_, 0, 0, false);
-    view_->InvalidateImmediate();
-    FlushViewEvents(context_, view_, true);
+    QElapsedTimer flushTimer;
+    flushTimer.start();
+    view_redrawn_ = false;
+    // input the controller ignored, e.g. moves without any effect, does not
+    // cost a view pass, the FBO keeps the previous frame
+    const Graphic3d_WorldViewProjState cameraState = view_->Camera()->WorldViewProjState();
+    if (input_changed_ || view_->IsInvalidated() || isInteracting() ||
+        cameraState != flushed_camera_state_)
+    {
+        OCC_TRACE_SCOPE("render", "FlushViewEvents");
+        FlushViewEvents(context_, view_, true);
+        flushed_camera_state_ = view_->Camera()->WorldViewProjState();
+    }
+    input_changed_ = false;
+    // the window is cleared before every pass, restore at least the scene
+    // kept in OCCT's own buffers and the immediate layer
+    if (underlay_ && !view_redrawn_)
+    {
+        OCC_TRACE_SCOPE("render", "V3d_View::RedrawImmediate");
+        view_->RedrawImmediate();
+    }
+    frame_timings_.flush_ms = double(flushTimer.nsecsElapsed()) / 1.0e6;
+    if (view_redrawn_)
+    {
+        last_draw_ms_ = frame_timings_.flush_ms;
+    }
+
+    if (!grab_requests_.empty())
+    {
+        OCC_TRACE_SCOPE("render", "captureGrabs");
+        captureGrabs(glCtx, targetFbo, size);
+    }
+    // keep frames coming until every readback is delivered
+    if (grabber_.isBusy() || !grab_requests_.empty())
+    {
+        requestUpdate();
+    }
+
+    // interaction is over, one more frame restores the full resolution
+    if (!isInteracting() &&
+        view_->RenderingParams().RenderResolutionScale < resolution_.settings().max_scale)
+    {
+        requestUpdate();
+    }
+
+    frame_timings_.render_ms = double(renderTimer.nsecsElapsed()) / 1.0e6;
+    publishFrameTimings(glCtx);
+}
+
+void OCCRenderer::requestGrab(const QSize &size, OccFrameGrabber::Callback done)
+{
+    grab_requests_.push_back({size, std::move(done)});
+}
+
+void OCCRenderer::captureGrabs(const Handle(OpenGl_Context) & glCtx,
+                               const Handle(OpenGl_FrameBuffer) & targetFbo,
+                               const QSize &frameSize)
+{
+    // no wrapper when the underlay draws into framebuffer 0
+    QOpenGLContext *qtContext = QOpenGLContext::currentContext();
+    // the FBO is allocated in buckets, read only the part the item shows
+    const QRect readRect = underlay_ || display_rect_.isEmpty()
+                               ? QRect(QPoint(), frameSize)
+                               : display_rect_.toRect();
+    size_t started = 0;
+    bool offscreen = false;
+    for (GrabRequest &request : grab_requests_)
+    {
+        bool ok = false;
+        if (request.size.isEmpty() || request.size == readRect.size())
+        {
+            if (targetFbo.IsNull())
+            {
+                qtContext->extraFunctions()->glBindFramebuffer(
+                    GL_READ_FRAMEBUFFER, qtContext->defaultFramebufferObject());
+            }
+            else
+            {
+                targetFbo->BindReadBuffer(glCtx);
+            }
+            ok = grabber_.capture(readRect, request.done);
+        }
+        else
+        {
+            ok = captureOffscreen(glCtx, request.size, request.done);
+            offscreen = offscreen || ok;
+        }
+        // all buffers in flight, the rest waits for the next frame
+        if (!ok)
+        {
+            break;
+        }
+        ++started;
+    }
+    grab_requests_.erase(grab_requests_.begin(), grab_requests_.begin() + started);
+
+    if (targetFbo.IsNull())
+    {
+        qtContext->functions()->glBindFramebuffer(GL_FRAMEBUFFER,
+                                                  qtContext->defaultFramebufferObject());
+    }
+    else
+    {
+        targetFbo->BindBuffer(glCtx);
+    }
+    if (offscreen)
+    {
+        // the offscreen pass reused the view's intermediate buffers
+        view_->Invalidate();
+    }
+}
+
+bool OCCRenderer::captureOffscreen(const Handle(OpenGl_Context) & glCtx, const QSize &size,
+                                   OccFrameGrabber::Callback &done)
+{
+    // don't render a view nobody can read back
+    if (!grabber_.hasFreeBuffer())
+    {
+        return false;
+    }
+
+    const Handle(Graphic3d_CView) &cview = view_->View();
+    Handle(OpenGl_FrameBuffer) fbo = Handle(OpenGl_FrameBuffer)::DownCast(grab_fbo_);
+    if (fbo.IsNull() || fbo->GetVPSizeX() != size.width() || fbo->GetVPSizeY() != size.height())
+    {
+        if (!grab_fbo_.IsNull())
+        {
+            cview->FBORelease(grab_fbo_);
+        }
+        grab_fbo_ = cview->FBOCreate(size.width(), size.height());
+        fbo = Handle(OpenGl_FrameBuffer)::DownCast(grab_fbo_);
+        if (fbo.IsNull())
+        {
+            qCWarning(lcOccRender) << "Grab FBO creation failed for" << size;
+            return false;
+        }
+    }
+
+    // same camera, aspect of the requested size, as V3d_View::ToPixMap()
+    const Handle(Graphic3d_Camera) &camera = view_->Camera();
+    Handle(Graphic3d_Camera) saved = new Graphic3d_Camera(camera);
+    camera->SetAspect(double(size.width()) / double(size.height()));
+
+    Handle(Standard_Transient) previous = cview->FBO();
+    cview->SetFBO(grab_fbo_);
+    view_->Invalidate();
+    view_->Redraw();
+
+    fbo->BindReadBuffer(glCtx);
+    const bool ok = grabber_.capture(QRect(QPoint(), size), done);
+    fbo->UnbindBuffer(glCtx);
+
+    cview->SetFBO(previous);
+    camera->Copy(saved);
+    return ok;
+}
+
+void OCCRenderer::publishFrameTimings(const Handle(OpenGl_Context) & glCtx)
+{
+    OccFrameTimings frame = frame_timings_;
+    frame_timings_ = OccFrameTimings();
+    if (!render_stats_)
+    {
+        return;
+    }
+
+    frame.skipped = !view_redrawn_;
+    const OccSelectionStats selection = scene_manager_->selectionStats();
+    frame.selection_pending = selection.pending;
+    frame.selection_lag_ms = selection.mean_lag_ms;
+    const OccMemoryStats memory = scene_manager_->memoryStats();
+    frame.triangulation_bytes = memory.triangulation_bytes;
+    frame.triangulation_peak_bytes = memory.triangulation_peak_bytes;
+    frame.presentation_bytes = memory.presentation_bytes;
+    frame.presentation_peak_bytes = memory.presentation_peak_bytes;
+    frame.evicted_shapes = memory.evictions;
+    const OccCullingStats culling = scene_manager_->cullingStats();
+    frame.objects_drawn = culling.drawn;
+    frame.objects_culled = culling.culled;
+    if (view_redrawn_ && !glCtx->FrameStats().IsNull())
+    {
+        const Graphic3d_FrameStatsData &data = glCtx->FrameStats()->LastDataFrame();
+        frame.triangles = data[Graphic3d_FrameStatsCounter_NbTrianglesVisible];
+        frame.elements = data[Graphic3d_FrameStatsCounter_NbElemsVisible];
+    }
+
+    OccRenderStats *stats = render_stats_;
+    QMetaObject::invokeMethod(
+        stats, [stats, frame]() { stats->addFrame(frame); }, Qt::QueuedConnection);
+}
+
+bool OCCRenderer::isInteracting() const
+{
+    return PressedMouseButtons() != Aspect_VKeyMouse_NONE || myToAskNextFrame ||
+           (!myViewAnimation.IsNull() && !myViewAnimation->IsStopped());
+}
+
+void OCCRenderer::applyResolutionScale(double scale)
+{
+    Graphic3d_RenderingParams &params = view_->ChangeRenderingParams();
+    if (std::abs(params.RenderResolutionScale - float(scale)) > 1.0e-3f)
+    {
+        params.RenderResolutionScale = float(scale);
+        view_->Invalidate();
+    }
+}
+
+void OCCRenderer::requestUpdate()
+{
+    if (quick_item_)
+    {
+        QMetaObject::invokeMethod(const_cast<OccViewerItem *>(quick_item_), "update",
+                                  Qt::QueuedConnection);
+    }
+}
+
+void OCCRenderer::requestUpdateAfter(int ms)
+{
+    if (quick_item_)
+    {
+        auto *item = const_cast<OccViewerItem *>(quick_item_);
+        QMetaObject::invokeMethod(
+            item, [item, ms]() { item->updateAfter(ms); }, Qt::QueuedConnection);
+    }
+}
+
+QSize OCCRenderer::bucketSize(const QSize &size)
+{
+    const auto roundUp = [](int pixels) {
+        return (std::max(pixels, 1) + RESIZE_BUCKET - 1) / RESIZE_BUCKET * RESIZE_BUCKET;
+    };
+    return QSize(roundUp(size.width()), roundUp(size.height()));
+}
+
+void OCCRenderer::updateFramebufferSize(const QSize &itemPixels)
+{
+    if (itemPixels != item_pixels_)
+    {
+        // the first size is final right away
+        if (item_pixels_.isValid())
+        {
+            resize_clock_.start();
+        }
+        item_pixels_ = itemPixels;
+    }
+    const bool settled = !resize_clock_.isValid() || resize_clock_.elapsed() >= RESIZE_SETTLE_MS;
+
+    // a larger item needs a new FBO at once, a smaller one gets it when
+    // resizing is over. createFramebufferObject() follows in this frame.
+    if (fbo_size_.isValid())
+    {
+        const bool outgrown = itemPixels.width() > fbo_size_.width() ||
+                              itemPixels.height() > fbo_size_.height();
+        if (outgrown || (settled && bucketSize(itemPixels) != fbo_size_))
+        {
+            invalidateFramebufferObject();
+            fbo_size_ = bucketSize(itemPixels);
+        }
+    }
+    const QSize fboSize = fbo_size_.isValid() ? fbo_size_ : bucketSize(itemPixels);
+
+    if (settled)
+    {
+        resize_clock_.invalidate();
+        view_size_ = itemPixels;
+        display_rect_ = QRectF(0, 0, itemPixels.width(), itemPixels.height());
+        return;
+    }
+
+    // OCCT's buffers keep their size while they cover the item and fit the
+    // FBO, else they take the FBO size. The item shows the top rows of the
+    // view, so that item and view pixels still match for input.
+    const bool viewFits = view_size_.isValid() && view_size_.width() <= fboSize.width() &&
+                          view_size_.height() <= fboSize.height() &&
+                          view_size_.width() >= itemPixels.width() &&
+                          view_size_.height() >= itemPixels.height();
+    if (!viewFits)
+    {
+        view_size_ = fboSize;
+    }
+    display_rect_ = QRectF(0, view_size_.height() - itemPixels.height(), itemPixels.width(),
+                           itemPixels.height());
+    requestUpdateAfter(RESIZE_SETTLE_MS - int(resize_clock_.elapsed()) + 1);
 }
 
 QOpenGLFramebufferObject *OCCRenderer::createFramebufferObject(const QSize &size)
@@ -168,11 +601,19 @@ QOpenGLFramebufferObject *OCCRenderer::createFramebufferObject(const QSize &size
 
     if (view_->Window().IsNull())
     {
-        std::cout << "[OCCRenderer] Initializing OpenGL context\n";
+        qCDebug(lcOccRender) << "Initializing OpenGL context";
         initializeGL(size);
     }
+    fbo_recreated_ = true;
 
-    return new QOpenGLFramebufferObject(size, format);
+    // offscreen users without an item get the exact size
+    if (quick_item_ == nullptr)
+    {
+        return new QOpenGLFramebufferObject(size, format);
+    }
+    fbo_size_ = bucketSize(size);
+    qCDebug(lcOccRender) << "Framebuffer" << fbo_size_ << "for" << size;
+    return new QOpenGLFramebufferObject(fbo_size_, format);
 }
 
 void OCCRenderer::initializeGL(const QSize &fboSize)
@@ -182,7 +623,7 @@ void OCCRenderer::initializeGL(const QSize &fboSize)
     // Get native window handle
     Aspect_Drawable aNativeWin;
 #ifdef _WIN32
-    std::cout << "[initializeGL] wglGetCurrentDC\n";
+    qCDebug(lcOccRender) << "initializeGL: wglGetCurrentDC";
     is_core_profile_ = true;
     HDC aWglDevCtx = wglGetCurrentDC();
     HWND aWglWin = WindowFromDC(aWglDevCtx);
@@ -210,11 +651,11 @@ void OCCRenderer::initializeGL(const QSize &fboSize)
     Handle(Aspect_NeutralWindow) aWindow = Handle(Aspect_NeutralWindow)::DownCast(view_->Window());
     if (!aWindow.IsNull())
     {
-        std::cout << "[initializeGL] aWindow is not null, setting native window handle\n";
+        qCDebug(lcOccRender) << "initializeGL: reusing window, setting native window handle";
     }
     else
     {
-        std::cout << "[initializeGL] aWindow is null, creating new window\n";
+        qCDebug(lcOccRender) << "initializeGL: creating new window";
         aWindow = new Aspect_NeutralWindow();
         aWindow->SetVirtual(true);
     }
@@ -224,59 +665,48 @@ void OCCRenderer::initializeGL(const QSize &fboSize)
     view_->SetWindow(aWindow, aGlCtx->RenderingContext());
 
     // Display viewcube after window is set
-    context_->Display(view_cube_, 0, 0, false);
-}
-
-void OCCRenderer::handleMousePressEvent(QMouseEvent *event)
-{
-    if (view_.IsNull() || myToAskNextFrame)
-        return;
-
-    const Graphic3d_Vec2i aClickPos(static_cast<int>(event->position().x() * scale_),
-                                    static_cast<int>(event->position().y() * scale_));
-    const Aspect_VKeyFlags aFlags = OcctGlTools::qtMouseModifiers2VKeys(event->modifiers());
-    const Aspect_VKeyMouse aButton = OcctGlTools::qtMouseButtons2VKeys(event->button());
-
-    if (UpdateMouseButtons(aClickPos, aButton, aFlags, false))
+    if (decorations_visible_)
     {
-        std::cout << "UpdateMouseButtons success" << std::endl;
+        context_->Display(view_cube_, 0, 0, false);
     }
 }
 
-void OCCRenderer::handleMouseReleaseEvent(QMouseEvent *event)
-{
-    if (view_.IsNull() || myToAskNextFrame)
-        return;
-
-    const Graphic3d_Vec2i aClickPos(static_cast<int>(event->position().x() * scale_),
-                                    static_cast<int>(event->position().y() * scale_));
-    const Aspect_VKeyFlags aFlags = OcctGlTools::qtMouseModifiers2VKeys(event->modifiers());
-    const Aspect_VKeyMouse aButtons = OcctGlTools::qtMouseButtons2VKeys(event->buttons());
-    std::ignore = UpdateMouseButtons(aClickPos, aButtons, aFlags, true);
-}
-
-void OCCRenderer::handleMouseMoveEvent(QMouseEvent *event)
+bool OCCRenderer::applyInput(const std::vector<OccInputEvent> &events)
 {
-    if (view_.IsNull() || myToAskNextFrame)
-        return;
-
-    const Graphic3d_Vec2i aNewPos(static_cast<int>(event->position().x() * scale_),
-                                  static_cast<int>(event->position().y() * scale_));
-    std::ignore =
-        UpdateMousePosition(aNewPos, PressedMouseButtons(),
-                            OcctGlTools::qtMouseModifiers2VKeys(event->modifiers()), false);
-}
-
-void OCCRenderer::handleHoverMoveEvent(QHoverEvent *event)
-{
-    if (view_.IsNull() || myToAskNextFrame)
-        return;
+    OCC_TRACE_SCOPE("input", "OCCRenderer::applyInput");
+    if (view_.IsNull())
+    {
+        return false;
+    }
 
-    const Graphic3d_Vec2i aNewPos(static_cast<int>(event->position().x() * scale_),
-                                  static_cast<int>(event->position().y() * scale_));
-    std::ignore =
-        UpdateMousePosition(aNewPos, Aspect_VKeyMouse_NONE,
-                            OcctGlTools::qtMouseModifiers2VKeys(event->modifiers()), false);
+    bool toRedraw = false;
+    for (const OccInputEvent &event : events)
+    {
+        const Graphic3d_Vec2i aPos(static_cast<int>(event.position.x() * scale_),
+                                   static_cast<int>(event.position.y() * scale_));
+        const Aspect_VKeyFlags aFlags = OcctGlTools::qtMouseModifiers2VKeys(event.modifiers);
+        switch (event.type)
+        {
+        case OccInputEvent::Type::Press:
+            toRedraw |= UpdateMouseButtons(aPos, OcctGlTools::qtMouseButtons2VKeys(event.buttons),
+                                           aFlags, false);
+            break;
+        case OccInputEvent::Type::Release:
+            toRedraw |= UpdateMouseButtons(aPos, OcctGlTools::qtMouseButtons2VKeys(event.buttons),
+                                           aFlags, true);
+            break;
+        case OccInputEvent::Type::Move:
+            toRedraw |= UpdateMousePosition(aPos, PressedMouseButtons(), aFlags, false);
+            break;
+        case OccInputEvent::Type::Hover:
+            toRedraw |= UpdateMousePosition(aPos, Aspect_VKeyMouse_NONE, aFlags, false);
+            break;
+        case OccInputEvent::Type::Wheel:
+            toRedraw |= UpdateZoom(Aspect_ScrollDelta(aPos, event.wheel_delta));
+            break;
+        }
+    }
+    return toRedraw;
 }
 
 void OCCRenderer::fitAll()
@@ -287,17 +717,24 @@ void OCCRenderer::fitAll()
     }
 }
 
-void OCCRenderer::handleWheelEvent(QWheelEvent *event)
+void OCCRenderer::setDecorationsVisible(bool visible)
 {
-    if (view_.IsNull() || myToAskNextFrame)
-        return;
-
-    const Graphic3d_Vec2i aPos(static_cast<int>(event->position().x() * scale_),
-                               static_cast<int>(event->position().y() * scale_));
-
-    const double aDelta = double(event->angleDelta().y()) / 8.0;
-
-    std::ignore = UpdateZoom(Aspect_ScrollDelta(aPos, aDelta));
+    decorations_visible_ = visible;
+    view_->ChangeRenderingParams().ToShowStats = visible;
+    if (visible)
+    {
+        viewer_->ActivateGrid(Aspect_GT_Rectangular, Aspect_GDM_Lines);
+        if (!view_->Window().IsNull())
+        {
+            context_->Display(view_cube_, 0, 0, false);
+        }
+    }
+    else
+    {
+        viewer_->DeactivateGrid();
+        context_->Remove(view_cube_, false);
+    }
+    view_->Invalidate();
 }
 
 void OCCRenderer::setViewCubeSize(double size)
@@ -331,12 +768,30 @@ void OCCRenderer::setViewCubePosition(int x, int y)
 void OCCRenderer::handleViewRedraw(const Handle(AIS_InteractiveContext) & theCtx,
                                    const Handle(V3d_View) & theView)
 {
-    AIS_ViewController::handleViewRedraw(theCtx, theView);
+    // camera has been updated by the view events at this point
+    // culling changes only the objects looked at by the level of detail
+    scene_manager_->updateCulling();
+    if (scene_manager_->updateLevelOfDetail() > 0)
+    {
+        theView->Invalidate();
+    }
 
-    if (myToAskNextFrame && quick_item_)
+    view_redrawn_ = view_redrawn_ || theView->IsInvalidated();
     {
-        QMetaObject::invokeMethod(const_cast<OccViewerItem *>(quick_item_), "update",
-                                  Qt::QueuedConnection);
+        OCC_TRACE_SCOPE("render", "V3d_View::Redraw");
+        AIS_ViewController::handleViewRedraw(theCtx, theView);
     }
+
+    if (myToAskNextFrame)
+    {
+        requestUpdate();
+    }
+}
+
+void OCCRenderer::handleDynamicHighlight(const Handle(AIS_InteractiveContext) & theCtx,
+                                         const Handle(V3d_View) & theView)
+{
+    OCC_TRACE_SCOPE("selection", "handleDynamicHighlight");
+    AIS_ViewController::handleDynamicHighlight(theCtx, theView);
 }
 } // namespace geotoys
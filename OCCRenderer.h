@@ -1,8 +1,11 @@
 #ifndef OCCRENDER_NEW_H
 #define OCCRENDER_NEW_H
 
+#include <vector>
+
 #include <QKeyEvent>
 #include <QMouseEvent>
+#include <QElapsedTimer>
 #include <QOpenGLExtraFunctions>
 #include <QOpenGLFramebufferObject>
 #include <QQuickFramebufferObject>
@@ -14,12 +17,17 @@
 #include <Aspect_NeutralWindow.hxx>
 #include <Aspect_VKey.hxx>
 #include <Graphic3d_GraphicDriver.hxx>
+#include <Graphic3d_WorldViewProjState.hxx>
 #include <OpenGl_Context.hxx>
 #include <OpenGl_FrameBuffer.hxx>
 #include <Standard_Handle.hxx>
 #include <V3d_View.hxx>
 #include <V3d_Viewer.hxx>
 
+#include "OccFrameGrabber.h"
+#include "OccInputQueue.h"
+#include "OccRenderStats.h"
+#include "OccResolutionController.h"
 #include "OccSceneManager.h"
 
 namespace geotoys
@@ -40,11 +48,22 @@ class OCCRenderer : public QQuickFramebufferObject::Renderer,
                     public AIS_ViewController
 {
 public:
+    // Item FBOs are allocated in steps of RESIZE_BUCKET pixels. While the
+    // item is being resized the view keeps the FBO size and the item shows
+    // its upper left part; once the size is stable for RESIZE_SETTLE_MS the
+    // view is laid out at the exact item size.
+    static const int RESIZE_BUCKET = 256;
+    static const int RESIZE_SETTLE_MS = 150;
+
     OCCRenderer(const OccViewerItem *item);
     ~OCCRenderer() override;
 
     void render() override;
     void synchronize(QQuickFramebufferObject *item) override;
+    // Underlay mode: draw into the window's framebuffer of the given pixel
+    // size inside QQuickWindow::beforeRenderPassRecording, below the QML
+    // content, instead of into the item's FBO
+    void renderUnderlay(const QSize &size);
 
     QOpenGLFramebufferObject *
     createFramebufferObject(const QSize &size) override;
@@ -53,24 +72,70 @@ public:
     {
         return scene_manager_;
     }
+    const Handle(V3d_View) & getView() const
+    {
+        return view_;
+    }
+    // Part of the FBO texture showing the view, in texture pixels with the
+    // OpenGL origin. Render thread, valid after synchronize().
+    const QRectF &displayRect() const
+    {
+        return display_rect_;
+    }
 
-    void handleWheelEvent(QWheelEvent *event);
-    void handleMousePressEvent(QMouseEvent *event);
-    void handleMouseReleaseEvent(QMouseEvent *event);
-    void handleMouseMoveEvent(QMouseEvent *event);
-    void handleHoverMoveEvent(QHoverEvent *event);
+    // Grid, view cube and frame statistics, hidden for offscreen snapshots
+    void setDecorationsVisible(bool visible);
+
+    // Apply input coalesced by the item since the previous frame, returns
+    // true when the view has to be redrawn
+    bool applyInput(const std::vector<OccInputEvent> &events);
 
     void fitAll();
 
+    // Read the next frame back without stalling, done runs on the render
+    // thread once the pixels arrived, usually one or two frames later. An
+    // empty size or the item size reads the displayed frame, other sizes
+    // render the view once more into an offscreen FBO of that size.
+    void requestGrab(const QSize &size, OccFrameGrabber::Callback done);
+    const OccGrabStats &grabStats() const
+    {
+        return grabber_.stats();
+    }
+
 protected:
     //! Handle view redraw for animation support
     void handleViewRedraw(const Handle(AIS_InteractiveContext) & theCtx,
                           const Handle(V3d_View) & theView) override;
+    //! Hover picking, traced as selection work
+    void handleDynamicHighlight(const Handle(AIS_InteractiveContext) & theCtx,
+                                const Handle(V3d_View) & theView) override;
 
 private:
     void initializeGL(const QSize &size);
+    // returns true when the view size changed
+    bool resizeView(const Graphic3d_Vec2i &size);
+    // frame work shared by the FBO and the underlay target
+    void renderScene(const Handle(OpenGl_Context) & glCtx,
+                     const Handle(OpenGl_FrameBuffer) & targetFbo, const QSize &size,
+                     const QElapsedTimer &renderTimer);
+    // mouse buttons held or camera animation running
+    bool isInteracting() const;
+    void applyResolutionScale(double scale);
+    // post the timings of the current pass to the item's stats object
+    void publishFrameTimings(const Handle(OpenGl_Context) & glCtx);
+    // schedule another frame from the render thread
+    void requestUpdate();
+    void requestUpdateAfter(int ms);
+    // pick the FBO and view sizes for an item of the given pixel size
+    void updateFramebufferSize(const QSize &itemPixels);
+    static QSize bucketSize(const QSize &size);
     void setViewCubeSize(double size);
     void setViewCubePosition(int x, int y);
+    // start the readback of the grabs requested before this frame
+    void captureGrabs(const Handle(OpenGl_Context) & glCtx,
+                      const Handle(OpenGl_FrameBuffer) & targetFbo, const QSize &frameSize);
+    bool captureOffscreen(const Handle(OpenGl_Context) & glCtx, const QSize &size,
+                          OccFrameGrabber::Callback &done);
 
 private:
     const OccViewerItem *quick_item_ = nullptr;
@@ -83,6 +148,41 @@ private:
     OccSceneManager *scene_manager_;
     double scale_ = 1.0;
     bool pending_fit_all_ = false;
+    bool fbo_recreated_ = false;
+    QSize item_pixels_;
+    QSize fbo_size_;
+    // invalid without an item, the view then follows the FBO
+    QSize view_size_;
+    QRectF display_rect_;
+    // runs while the item size keeps changing
+    QElapsedTimer resize_clock_;
+    bool decorations_visible_ = true;
+    // current frame goes to the window framebuffer, see renderUnderlay()
+    bool underlay_ = false;
+    // time per frame spent displaying shapes meshed in background
+    double commit_budget_ms_ = 4.0;
+
+    OccResolutionController resolution_;
+    // flush time of the last frame which redrew the view
+    double last_draw_ms_ = 0.0;
+
+    // owned by the item on the GUI thread, only reached via queued calls
+    OccRenderStats *render_stats_ = nullptr;
+    OccFrameTimings frame_timings_;
+    bool view_redrawn_ = false;
+    // applyInput() or a scene command changed something since the last view pass
+    bool input_changed_ = false;
+    Graphic3d_WorldViewProjState flushed_camera_state_;
+
+    struct GrabRequest
+    {
+        QSize size;
+        OccFrameGrabber::Callback done;
+    };
+    OccFrameGrabber grabber_;
+    std::vector<GrabRequest> grab_requests_;
+    // OpenGl_FrameBuffer from Graphic3d_CView::FBOCreate(), custom grab sizes
+    Handle(Standard_Transient) grab_fbo_;
 };
 } // namespace geotoys
 #endif // OCCRENDER_H
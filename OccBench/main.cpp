@@ -0,0 +1,832 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QSurfaceFormat>
+
+#include <BRepPrimAPI_MakeBox.hxx>
+#include <BRepPrimAPI_MakeCylinder.hxx>
+#include <BRepPrimAPI_MakeSphere.hxx>
+#include <BRepPrimAPI_MakeTorus.hxx>
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <Graphic3d_Camera.hxx>
+#include <Poly_Triangulation.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
+#include <V3d_View.hxx>
+#include <gp_Ax2.hxx>
+#include <gp_Trsf.hxx>
+
+#include "OCCRenderer.h"
+#include "OccFileLoader.h"
+#include "OccIdRegistry.h"
+#include "OccSceneManager.h"
+
+using namespace geotoys;
+
+// Scene scaling benchmark. Synthetic scenes are added through
+// OccSceneManager and rendered offscreen through OCCRenderer, results are
+// written as JSON. Runs under Mesa llvmpipe, e.g.
+//   xvfb-run -a OccBench --boxes 1000,10000,100000 -o bench.json
+namespace
+{
+struct Scenario
+{
+    std::string name;
+    // meshing parameters, the defaults unless the scenario needs finer ones
+    OccMeshParameters mesh_params;
+    std::function<std::vector<OccShapeDesc>()> build;
+};
+
+std::vector<OccShapeDesc> makeBoxGrid(int count)
+{
+    const int side = static_cast<int>(std::ceil(std::sqrt(double(count))));
+    std::vector<OccShapeDesc> shapes;
+    shapes.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        OccShapeDesc desc;
+        desc.id = "box_" + std::to_string(i);
+        desc.shape = BRepPrimAPI_MakeBox(gp_Pnt((i % side) * 20.0, (i / side) * 20.0, 0.0),
+                                         10.0, 10.0, 10.0)
+                         .Shape();
+        desc.color = Quantity_Color(double(i % side) / side, double(i / side) / side,
+                                    0.5, Quantity_TOC_RGB);
+        shapes.push_back(std::move(desc));
+    }
+    return shapes;
+}
+
+// Few curved shapes meshed with a fine deflection
+std::vector<OccShapeDesc> makeDenseShapes(int count)
+{
+    std::vector<OccShapeDesc> shapes;
+    for (int i = 0; i < count; ++i)
+    {
+        const gp_Pnt center((i % 4) * 120.0, (i / 4) * 120.0, 0.0);
+        OccShapeDesc desc;
+        desc.id = "dense_" + std::to_string(i);
+        desc.shape = (i % 2 == 0)
+                         ? BRepPrimAPI_MakeSphere(center, 50.0).Shape()
+                         : BRepPrimAPI_MakeTorus(gp_Ax2(center, gp::DZ()), 40.0, 15.0)
+                               .Shape();
+        desc.color = Quantity_NOC_STEELBLUE;
+        shapes.push_back(std::move(desc));
+    }
+    return shapes;
+}
+
+// Compounds of a plate with pins, balls and a ring, like small assemblies
+std::vector<OccShapeDesc> makeAssemblies(int count)
+{
+    const int side = static_cast<int>(std::ceil(std::sqrt(double(count))));
+    std::vector<OccShapeDesc> shapes;
+    shapes.reserve(count);
+    BRep_Builder builder;
+    for (int i = 0; i < count; ++i)
+    {
+        const double x = (i % side) * 150.0;
+        const double y = (i / side) * 150.0;
+        TopoDS_Compound compound;
+        builder.MakeCompound(compound);
+        builder.Add(compound, BRepPrimAPI_MakeBox(gp_Pnt(x, y, 0.0), 100.0, 100.0, 10.0).Shape());
+        for (int pin = 0; pin < 8; ++pin)
+        {
+            const gp_Pnt base(x + 10.0 + (pin % 4) * 25.0, y + 20.0 + (pin / 4) * 60.0, 10.0);
+            builder.Add(compound,
+                        BRepPrimAPI_MakeCylinder(gp_Ax2(base, gp::DZ()), 4.0, 30.0).Shape());
+        }
+        for (int ball = 0; ball < 4; ++ball)
+        {
+            const gp_Pnt center(x + 20.0 + ball * 20.0, y + 50.0, 20.0);
+            builder.Add(compound, BRepPrimAPI_MakeSphere(center, 8.0).Shape());
+        }
+        builder.Add(compound, BRepPrimAPI_MakeTorus(
+                                  gp_Ax2(gp_Pnt(x + 50.0, y + 50.0, 45.0), gp::DZ()), 30.0, 5.0)
+                                  .Shape());
+
+        OccShapeDesc desc;
+        desc.id = "assembly_" + std::to_string(i);
+        desc.shape = compound;
+        desc.color = Quantity_NOC_GOLDENROD;
+        shapes.push_back(std::move(desc));
+    }
+    return shapes;
+}
+
+// One model path per line, empty lines and # comments are skipped
+QStringList readPathList(const QString &path)
+{
+    QStringList paths;
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        while (!file.atEnd())
+        {
+            const QString line = QString::fromUtf8(file.readLine()).trimmed();
+            if (!line.isEmpty() && !line.startsWith('#'))
+            {
+                paths << line;
+            }
+        }
+    }
+    return paths;
+}
+
+// Resident set size in bytes, 0 where not available
+uint64_t residentMemory()
+{
+#if defined(__linux__)
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly))
+    {
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1)
+        {
+            return fields[1].toULongLong() * uint64_t(sysconf(_SC_PAGESIZE));
+        }
+    }
+#endif
+    return 0;
+}
+
+uint64_t countTriangles(const OccSceneManager &scene)
+{
+    uint64_t triangles = 0;
+    for (const std::string &id : scene.getAllShapeIds())
+    {
+        Handle(AIS_Shape) aisShape = scene.getShape(id);
+        if (aisShape.IsNull())
+        {
+            continue;
+        }
+        for (TopExp_Explorer exp(aisShape->Shape(), TopAbs_FACE); exp.More(); exp.Next())
+        {
+            TopLoc_Location location;
+            Handle(Poly_Triangulation) triangulation =
+                BRep_Tool::Triangulation(TopoDS::Face(exp.Current()), location);
+            if (!triangulation.IsNull())
+            {
+                triangles += triangulation->NbTriangles();
+            }
+        }
+    }
+    return triangles;
+}
+
+// Nearest rank percentile of sorted samples
+double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    const size_t rank = static_cast<size_t>(std::ceil(p * double(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+double elapsedMs(const QElapsedTimer &timer)
+{
+    return double(timer.nsecsElapsed()) / 1.0e6;
+}
+
+// Assembly like ids, 100 parts per sub-assembly and 10 sub-assemblies each
+QString registryId(int index)
+{
+    return QStringLiteral("asm_%1/sub_%2/part_%3")
+        .arg(index / 1000)
+        .arg((index / 100) % 10)
+        .arg(index);
+}
+
+// Per operation cost of the GUI side id registry, should stay flat with
+// the number of ids
+QJsonObject runRegistry(int count)
+{
+    std::vector<QString> ids;
+    ids.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        ids.push_back(registryId(i));
+    }
+    const double perOp = 1.0e6 / std::max(count, 1);
+
+    OccIdRegistry registry;
+    QElapsedTimer timer;
+    timer.start();
+    for (const QString &id : ids)
+    {
+        registry.insert(id);
+    }
+    const double insertNs = elapsedMs(timer) * perOp;
+
+    timer.restart();
+    size_t hits = 0;
+    for (const QString &id : ids)
+    {
+        hits += registry.key(id).empty() ? 0 : 1;
+    }
+    const double lookupNs = elapsedMs(timer) * perOp;
+
+    QStringList added;
+    QStringList removed;
+    bool reset = false;
+    timer.restart();
+    registry.takeChanges(added, removed, reset);
+    const double changesMs = elapsedMs(timer);
+
+    // one sub-assembly of 100 parts per query
+    const int groups = std::max(count / 100, 1);
+    timer.restart();
+    size_t grouped = 0;
+    for (int group = 0; group < groups; ++group)
+    {
+        grouped += registry.keysUnder(QStringLiteral("asm_%1/sub_%2")
+                                          .arg(group / 10)
+                                          .arg(group % 10))
+                       .size();
+    }
+    const double groupNs = elapsedMs(timer) * 1.0e6 / groups;
+
+    // remove every second sub-assembly through the groups
+    timer.restart();
+    int removedCount = 0;
+    for (int group = 0; group < groups; group += 2)
+    {
+        for (const QString &id :
+             registry.idsUnder(QStringLiteral("asm_%1/sub_%2").arg(group / 10).arg(group % 10)))
+        {
+            removedCount += registry.remove(id) ? 1 : 0;
+        }
+    }
+    const double removeNs =
+        removedCount > 0 ? elapsedMs(timer) * 1.0e6 / removedCount : 0.0;
+
+    timer.restart();
+    registry.clear();
+    const double clearMs = elapsedMs(timer);
+
+    QJsonObject result;
+    result["ids"] = count;
+    result["lookup_hits"] = qint64(hits);
+    result["insert_ns"] = insertNs;
+    result["lookup_ns"] = lookupNs;
+    result["take_changes_ms"] = changesMs;
+    result["changes"] = added.size() + removed.size();
+    result["group_query_ns"] = groupNs;
+    result["group_ids"] = qint64(grouped);
+    result["remove_ns"] = removeNs;
+    result["clear_ms"] = clearMs;
+    return result;
+}
+
+class Bench
+{
+public:
+    Bench(QOpenGLContext &context, const QSize &size, int frames)
+        : gl_(context.functions())
+        , frames_(frames)
+        , renderer_(std::make_unique<OCCRenderer>(nullptr))
+    {
+        fbo_.reset(renderer_->createFramebufferObject(size));
+        renderer_->setDecorationsVisible(false);
+    }
+
+    ~Bench()
+    {
+        renderer_->getSceneManager()->clearAllShapes();
+        fbo_.reset();
+        renderer_.reset();
+    }
+
+    QJsonObject run(const Scenario &scenario)
+    {
+        OccSceneManager *scene = renderer_->getSceneManager();
+        scene->clearAllShapes();
+        scene->setMeshParameters(scenario.mesh_params);
+        renderFrame();
+
+        std::vector<OccShapeDesc> shapes = scenario.build();
+        const uint64_t rssBefore = residentMemory();
+
+        // same path as the application: meshed in background, committed
+        // within the per frame budget
+        QElapsedTimer timer;
+        timer.start();
+        scene->addShapesAsync(shapes);
+        renderer_->fitAll();
+        int loadFrames = 0;
+        while (scene->hasPendingShapes())
+        {
+            renderFrame();
+            ++loadFrames;
+        }
+        const double addMs = elapsedMs(timer);
+        // one more frame for the pending fitAll and the complete scene
+        renderFrame();
+        const double firstFrameMs = elapsedMs(timer);
+
+        // orbit around the scene center
+        std::vector<double> frameTimes;
+        frameTimes.reserve(frames_);
+        const Handle(V3d_View) &view = renderer_->getView();
+        const gp_Pnt center = view->Camera()->Center();
+        gp_Trsf orbit;
+        orbit.SetRotation(gp_Ax1(center, gp::DZ()), 2.0 * M_PI / std::max(frames_, 1));
+        for (int frame = 0; frame < frames_; ++frame)
+        {
+            view->Camera()->Transform(orbit);
+            view->Invalidate();
+            QElapsedTimer frameTimer;
+            frameTimer.start();
+            renderFrame();
+            frameTimes.push_back(elapsedMs(frameTimer));
+        }
+        std::sort(frameTimes.begin(), frameTimes.end());
+        double frameSum = 0.0;
+        for (double ms : frameTimes)
+        {
+            frameSum += ms;
+        }
+
+        const uint64_t rss = residentMemory();
+        QJsonObject result;
+        result["name"] = QString::fromStdString(scenario.name);
+        result["shapes"] = qint64(shapes.size());
+        result["triangles"] = qint64(countTriangles(*scene));
+        result["add_ms"] = addMs;
+        result["add_shapes_per_sec"] = addMs > 0.0 ? shapes.size() * 1000.0 / addMs : 0.0;
+        result["load_frames"] = loadFrames;
+        result["first_frame_ms"] = firstFrameMs;
+        result["frame_ms_mean"] = frameTimes.empty() ? 0.0 : frameSum / frameTimes.size();
+        result["frame_ms_p50"] = percentile(frameTimes, 0.50);
+        result["frame_ms_p99"] = percentile(frameTimes, 0.99);
+        result["frame_ms_max"] = frameTimes.empty() ? 0.0 : frameTimes.back();
+        result["rss_bytes"] = qint64(rss);
+        result["rss_delta_bytes"] = qint64(rss) - qint64(rssBefore);
+        return result;
+    }
+
+    // Multi-file load through OccFileLoader, threads 1 is the sequential
+    // baseline. Reports wall time and peak resident memory.
+    QJsonObject runFiles(const QStringList &paths, int threads)
+    {
+        OccSceneManager *scene = renderer_->getSceneManager();
+        scene->clearAllShapes();
+        scene->setMeshParameters(OccMeshParameters());
+        renderFrame();
+
+        OccFileLoader loader([scene](const std::vector<OccShapeDesc> &shapes) {
+            scene->addShapesAsync(shapes);
+        });
+        OccFileLoadSettings settings;
+        settings.threads = threads;
+        loader.setSettings(settings);
+        // failed and cancelled shapes also complete a file
+        QObject::connect(scene, &OccSceneManager::shapeReady, &loader,
+                         &OccFileLoader::shapeReady);
+        QObject::connect(scene, &OccSceneManager::shapeFailed, &loader,
+                         &OccFileLoader::shapeFailed);
+        QObject::connect(scene, &OccSceneManager::shapeCancelled, &loader,
+                         &OccFileLoader::shapeCancelled);
+        int failed = 0;
+        QObject::connect(&loader, &OccFileLoader::finished,
+                         [&failed](int, int count, double) { failed = count; });
+
+        const uint64_t rssBefore = residentMemory();
+        uint64_t rssPeak = rssBefore;
+        QElapsedTimer timer;
+        timer.start();
+        loader.load(paths, "files");
+        while (loader.isLoading() || scene->hasPendingShapes())
+        {
+            QCoreApplication::processEvents();
+            renderFrame();
+            rssPeak = std::max(rssPeak, residentMemory());
+        }
+        const double loadMs = elapsedMs(timer);
+        QObject::disconnect(scene, &OccSceneManager::shapeReady, &loader,
+                            &OccFileLoader::shapeReady);
+        QObject::disconnect(scene, &OccSceneManager::shapeFailed, &loader,
+                            &OccFileLoader::shapeFailed);
+        QObject::disconnect(scene, &OccSceneManager::shapeCancelled, &loader,
+                            &OccFileLoader::shapeCancelled);
+
+        QJsonObject result;
+        result["name"] = QStringLiteral("files_%1_threads_%2").arg(paths.size()).arg(threads);
+        result["files"] = paths.size();
+        result["failed"] = failed;
+        result["threads"] = threads;
+        result["load_ms"] = loadMs;
+        result["files_per_sec"] = loadMs > 0.0 ? paths.size() * 1000.0 / loadMs : 0.0;
+        result["triangles"] = qint64(countTriangles(*scene));
+        result["rss_peak_bytes"] = qint64(rssPeak);
+        result["rss_peak_delta_bytes"] = qint64(rssPeak) - qint64(rssBefore);
+        return result;
+    }
+
+    // Continuous capture of an orbiting box grid: no readback, a blocking
+    // glReadPixels per frame and OCCRenderer::requestGrab() per frame, at the
+    // framebuffer size and, offscreen, at half of it. Frames are not finished
+    // individually, the pipelining of the readback is what is measured.
+    QJsonArray runGrab(int boxes)
+    {
+        OccSceneManager *scene = renderer_->getSceneManager();
+        scene->clearAllShapes();
+        OccMeshParameters params;
+        params.lod_levels = 1;
+        scene->setMeshParameters(params);
+        scene->addShapesAsync(makeBoxGrid(boxes));
+        renderer_->fitAll();
+        while (scene->hasPendingShapes())
+        {
+            renderFrame();
+        }
+        renderFrame();
+
+        const QSize size = fbo_->size();
+        QJsonArray results;
+        for (const char *mode : {"none", "sync", "async", "async_offscreen"})
+        {
+            const std::string name = mode;
+            const bool async = name.rfind("async", 0) == 0;
+            const QSize grabSize = name == "async_offscreen" ? size / 2 : size;
+            // outlives the loop if a readback never arrives
+            auto delivery = std::make_shared<std::pair<int, double>>(0, 0.0);
+            int &delivered = delivery->first;
+            const Handle(V3d_View) &view = renderer_->getView();
+            const gp_Pnt center = view->Camera()->Center();
+            gp_Trsf orbit;
+            orbit.SetRotation(gp_Ax1(center, gp::DZ()), 0.01);
+
+            QElapsedTimer timer;
+            timer.start();
+            for (int frame = 0; frame < frames_; ++frame)
+            {
+                view->Camera()->Transform(orbit);
+                view->Invalidate();
+                fbo_->bind();
+                if (async)
+                {
+                    renderer_->requestGrab(grabSize, [delivery](const QImage &, double latencyMs) {
+                        ++delivery->first;
+                        delivery->second += latencyMs;
+                    });
+                }
+                renderer_->render();
+                if (name == "sync")
+                {
+                    QImage image(size, QImage::Format_RGBA8888);
+                    fbo_->bind();
+                    gl_->glReadPixels(0, 0, size.width(), size.height(), GL_RGBA,
+                                      GL_UNSIGNED_BYTE, image.bits());
+                    ++delivered;
+                }
+                fbo_->release();
+            }
+            // the remaining readbacks are delivered by the following frames
+            for (int extra = 0; async && delivered < frames_ && extra < frames_ + 10; ++extra)
+            {
+                fbo_->bind();
+                renderer_->render();
+                fbo_->release();
+            }
+            gl_->glFinish();
+            const double totalMs = elapsedMs(timer);
+
+            QJsonObject result;
+            result["name"] = QStringLiteral("grab_%1").arg(mode);
+            result["shapes"] = boxes;
+            result["width"] = grabSize.width();
+            result["height"] = grabSize.height();
+            result["frames"] = frames_;
+            result["total_ms"] = totalMs;
+            result["fps"] = totalMs > 0.0 ? frames_ * 1000.0 / totalMs : 0.0;
+            result["grabs_per_sec"] = totalMs > 0.0 ? delivered * 1000.0 / totalMs : 0.0;
+            result["grabs"] = delivered;
+            result["latency_ms_mean"] = async && delivered > 0 ? delivery->second / delivered : 0.0;
+            results.append(result);
+        }
+        return results;
+    }
+
+    // Cost of the FBO item against the window underlay on an orbiting box
+    // grid. The window framebuffer is stood in for by another FBO and Qt's
+    // composition passes by full screen blits: "underlay" renders straight
+    // into it, "fbo" renders into the item FBO and copies it over, "fbo_layer"
+    // adds the copy of an item layer. Bytes are the color traffic of the
+    // copies, one read and one write per pixel each.
+    QJsonArray runComposite(int boxes)
+    {
+        OccSceneManager *scene = renderer_->getSceneManager();
+        scene->clearAllShapes();
+        OccMeshParameters params;
+        params.lod_levels = 1;
+        scene->setMeshParameters(params);
+        scene->addShapesAsync(makeBoxGrid(boxes));
+        renderer_->fitAll();
+        while (scene->hasPendingShapes())
+        {
+            renderFrame();
+        }
+        renderFrame();
+
+        const QSize size = fbo_->size();
+        QOpenGLFramebufferObjectFormat format;
+        format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+        format.setInternalTextureFormat(GL_RGBA8);
+        QOpenGLFramebufferObject window(size, format);
+        QOpenGLFramebufferObject layer(size, format);
+        QOpenGLExtraFunctions *extra = QOpenGLContext::currentContext()->extraFunctions();
+        const auto copy = [&](const QOpenGLFramebufferObject &from,
+                              const QOpenGLFramebufferObject &to) {
+            extra->glBindFramebuffer(GL_READ_FRAMEBUFFER, from.handle());
+            extra->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, to.handle());
+            extra->glBlitFramebuffer(0, 0, size.width(), size.height(), 0, 0, size.width(),
+                                     size.height(), GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        };
+
+        QJsonArray results;
+        for (const char *mode : {"underlay", "fbo", "fbo_layer"})
+        {
+            const std::string name = mode;
+            const int copies = name == "underlay" ? 0 : (name == "fbo" ? 1 : 2);
+            const Handle(V3d_View) &view = renderer_->getView();
+            const gp_Pnt center = view->Camera()->Center();
+            gp_Trsf orbit;
+            orbit.SetRotation(gp_Ax1(center, gp::DZ()), 0.01);
+
+            std::vector<double> frameTimes;
+            frameTimes.reserve(frames_);
+            for (int frame = 0; frame < frames_; ++frame)
+            {
+                view->Camera()->Transform(orbit);
+                view->Invalidate();
+                QElapsedTimer frameTimer;
+                frameTimer.start();
+                if (copies == 0)
+                {
+                    window.bind();
+                    renderer_->render();
+                }
+                else
+                {
+                    fbo_->bind();
+                    renderer_->render();
+                    if (copies == 2)
+                    {
+                        copy(*fbo_, layer);
+                        copy(layer, window);
+                    }
+                    else
+                    {
+                        copy(*fbo_, window);
+                    }
+                }
+                gl_->glFinish();
+                frameTimes.push_back(elapsedMs(frameTimer));
+            }
+            QOpenGLFramebufferObject::bindDefault();
+            std::sort(frameTimes.begin(), frameTimes.end());
+            double frameSum = 0.0;
+            for (double ms : frameTimes)
+            {
+                frameSum += ms;
+            }
+
+            QJsonObject result;
+            result["name"] = QStringLiteral("composite_%1").arg(mode);
+            result["shapes"] = boxes;
+            result["frames"] = frames_;
+            result["copies_per_frame"] = copies;
+            result["copy_bytes_per_frame"] =
+                qint64(copies) * 2 * qint64(size.width()) * size.height() * 4;
+            result["frame_ms_mean"] = frameTimes.empty() ? 0.0 : frameSum / frameTimes.size();
+            result["frame_ms_p50"] = percentile(frameTimes, 0.50);
+            result["frame_ms_p99"] = percentile(frameTimes, 0.99);
+            results.append(result);
+        }
+        return results;
+    }
+
+private:
+    // render and wait for the GPU, so that the timings include the driver
+    void renderFrame()
+    {
+        fbo_->bind();
+        renderer_->render();
+        gl_->glFinish();
+        fbo_->release();
+    }
+
+private:
+    QOpenGLFunctions *gl_ = nullptr;
+    int frames_ = 0;
+    std::unique_ptr<OCCRenderer> renderer_;
+    std::unique_ptr<QOpenGLFramebufferObject> fbo_;
+};
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QSurfaceFormat aGlFormat;
+    aGlFormat.setDepthBufferSize(24);
+    aGlFormat.setStencilBufferSize(8);
+#if defined(_WIN32)
+    aGlFormat.setVersion(4, 5);
+    aGlFormat.setProfile(QSurfaceFormat::CoreProfile);
+#else
+    aGlFormat.setVersion(3, 3);
+    aGlFormat.setProfile(QSurfaceFormat::CompatibilityProfile);
+#endif
+    QSurfaceFormat::setDefaultFormat(aGlFormat);
+
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Scene scaling benchmark, prints JSON");
+    parser.addHelpOption();
+    QCommandLineOption boxesOption("boxes", "Comma separated box counts.", "list",
+                                   "1000,10000,100000");
+    QCommandLineOption denseOption("dense", "Number of finely meshed curved shapes.",
+                                   "count", "16");
+    QCommandLineOption assembliesOption("assemblies", "Number of assemblies.", "count",
+                                        "500");
+    QCommandLineOption framesOption("frames", "Measured frames per scenario.", "count",
+                                    "120");
+    QCommandLineOption registryOption("registry", "Comma separated id registry sizes.",
+                                      "list", "10000,100000,1000000");
+    QCommandLineOption filesOption("files", "File with one model path per line to load.",
+                                   "file");
+    QCommandLineOption loadThreadsOption(
+        "load-threads", "Comma separated reader thread counts, 0 is the core count.", "list",
+        "1,0");
+    QCommandLineOption grabOption("grab", "Frame readback on a grid of that many boxes.",
+                                  "boxes", "0");
+    QCommandLineOption compositeOption(
+        "composite", "FBO item against window underlay on a grid of that many boxes.", "boxes",
+        "0");
+    QCommandLineOption sizeOption({"s", "size"}, "Framebuffer size.", "WxH", "1280x720");
+    QCommandLineOption outputOption({"o", "output"}, "Write JSON to a file.", "file");
+    parser.addOptions(
+        {boxesOption, denseOption, assembliesOption, framesOption, registryOption, filesOption,
+         loadThreadsOption, grabOption, compositeOption, sizeOption, outputOption});
+    parser.process(app);
+
+    const QStringList sizeParts = parser.value(sizeOption).toLower().split('x');
+    const QSize size = sizeParts.size() == 2
+                           ? QSize(sizeParts[0].toInt(), sizeParts[1].toInt())
+                           : QSize();
+    if (size.width() <= 0 || size.height() <= 0)
+    {
+        std::cerr << "Invalid framebuffer size" << std::endl;
+        return 1;
+    }
+
+    std::vector<Scenario> scenarios;
+    for (const QString &text : parser.value(boxesOption).split(',', Qt::SkipEmptyParts))
+    {
+        const int count = text.trimmed().toInt();
+        if (count > 0)
+        {
+            // boxes are flat, coarser levels would only cost time
+            OccMeshParameters params;
+            params.lod_levels = 1;
+            scenarios.push_back({"boxes_" + std::to_string(count), params,
+                                 [count]() { return makeBoxGrid(count); }});
+        }
+    }
+    const int denseCount = parser.value(denseOption).toInt();
+    if (denseCount > 0)
+    {
+        OccMeshParameters params;
+        params.deviation_coefficient = 0.00005;
+        params.deviation_angle = 0.05;
+        scenarios.push_back({"dense_" + std::to_string(denseCount), params,
+                             [denseCount]() { return makeDenseShapes(denseCount); }});
+    }
+    const int assemblyCount = parser.value(assembliesOption).toInt();
+    if (assemblyCount > 0)
+    {
+        scenarios.push_back({"assemblies_" + std::to_string(assemblyCount), OccMeshParameters(),
+                             [assemblyCount]() { return makeAssemblies(assemblyCount); }});
+    }
+
+    QOpenGLContext glContext;
+    glContext.setFormat(aGlFormat);
+    QOffscreenSurface surface;
+    surface.setFormat(aGlFormat);
+    surface.create();
+    if (!glContext.create() || !glContext.makeCurrent(&surface))
+    {
+        std::cerr << "Cannot create OpenGL context" << std::endl;
+        return 1;
+    }
+
+    QJsonObject report;
+    report["gl_renderer"] = QString::fromLatin1(
+        reinterpret_cast<const char *>(glContext.functions()->glGetString(GL_RENDERER)));
+    report["width"] = size.width();
+    report["height"] = size.height();
+    report["frames"] = parser.value(framesOption).toInt();
+
+    QJsonArray results;
+    {
+        Bench bench(glContext, size, parser.value(framesOption).toInt());
+        for (const Scenario &scenario : scenarios)
+        {
+            std::cerr << "running " << scenario.name << std::endl;
+            results.append(bench.run(scenario));
+        }
+        if (parser.isSet(filesOption))
+        {
+            const QStringList paths = readPathList(parser.value(filesOption));
+            for (const QString &text :
+                 parser.value(loadThreadsOption).split(',', Qt::SkipEmptyParts))
+            {
+                const int threads = std::max(text.trimmed().toInt(), 0);
+                std::cerr << "running files with " << threads << " threads" << std::endl;
+                results.append(bench.runFiles(paths, threads));
+            }
+        }
+        const int grabBoxes = parser.value(grabOption).toInt();
+        if (grabBoxes > 0)
+        {
+            std::cerr << "running grab" << std::endl;
+            for (const QJsonValue &result : bench.runGrab(grabBoxes))
+            {
+                results.append(result);
+            }
+        }
+        const int compositeBoxes = parser.value(compositeOption).toInt();
+        if (compositeBoxes > 0)
+        {
+            std::cerr << "running composite" << std::endl;
+            for (const QJsonValue &result : bench.runComposite(compositeBoxes))
+            {
+                results.append(result);
+            }
+        }
+    }
+    glContext.doneCurrent();
+    report["scenarios"] = results;
+
+    QJsonArray registryResults;
+    for (const QString &text : parser.value(registryOption).split(',', Qt::SkipEmptyParts))
+    {
+        const int count = text.trimmed().toInt();
+        if (count > 0)
+        {
+            std::cerr << "running registry_" << count << std::endl;
+            registryResults.append(runRegistry(count));
+        }
+    }
+    report["registry"] = registryResults;
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size())
+        {
+            std::cerr << "Cannot write " << parser.value(outputOption).toStdString()
+                      << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        std::cout << json.constData();
+    }
+    return 0;
+}
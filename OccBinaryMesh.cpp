@@ -0,0 +1,181 @@
+#include "OccBinaryMesh.h"
+
+#include <climits>
+#include <cstring>
+
+#include <Poly_Triangle.hxx>
+#include <gp_Pnt.hxx>
+#include <gp_Vec3f.hxx>
+
+namespace geotoys
+{
+
+namespace
+{
+const char BINARY_MESH_MAGIC[4] = {'O', 'C', 'C', 'M'};
+const size_t HEADER_SIZE = 16;
+
+void setError(std::string *error, const std::string &message)
+{
+    if (error)
+    {
+        *error = message;
+    }
+}
+
+template <typename T>
+T readAt(const char *data, size_t offset)
+{
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return value;
+}
+
+// positions, normals and colors behind the indices
+void copyVertices(const char *data, const OccBinaryMesh::Header &header,
+                  const Handle(Poly_Triangulation) & triangulation,
+                  Handle(TColStd_HArray1OfInteger) & colors)
+{
+    const int nbNodes = int(header.vertex_count);
+    size_t offset = HEADER_SIZE;
+    for (int i = 1; i <= nbNodes; ++i, offset += 3 * sizeof(float))
+    {
+        float xyz[3];
+        std::memcpy(xyz, data + offset, sizeof(xyz));
+        triangulation->SetNode(i, gp_Pnt(xyz[0], xyz[1], xyz[2]));
+    }
+    offset += size_t(header.triangle_count) * 3 * sizeof(uint32_t);
+
+    if ((header.flags & OccBinaryMesh::HAS_NORMALS) != 0)
+    {
+        if (!triangulation->HasNormals())
+        {
+            triangulation->AddNormals();
+        }
+        for (int i = 1; i <= nbNodes; ++i, offset += 3 * sizeof(float))
+        {
+            float normal[3];
+            std::memcpy(normal, data + offset, sizeof(normal));
+            triangulation->SetNormal(i, gp_Vec3f(normal[0], normal[1], normal[2]));
+        }
+    }
+    else
+    {
+        triangulation->ComputeNormals();
+    }
+
+    if ((header.flags & OccBinaryMesh::HAS_COLORS) != 0)
+    {
+        // AIS_Triangulation reads the bytes of each integer as R, G, B
+        if (colors.IsNull() || colors->Length() != nbNodes)
+        {
+            colors = new TColStd_HArray1OfInteger(1, nbNodes);
+        }
+        for (int i = 1; i <= nbNodes; ++i, offset += 4)
+        {
+            colors->SetValue(i, readAt<int32_t>(data, offset));
+        }
+    }
+}
+} // namespace
+
+bool OccBinaryMesh::readHeader(const QByteArray &data, Header &header,
+                               std::string *error)
+{
+    if (size_t(data.size()) < HEADER_SIZE ||
+        std::memcmp(data.constData(), BINARY_MESH_MAGIC, 4) != 0)
+    {
+        setError(error, "not a binary mesh");
+        return false;
+    }
+    header.flags = readAt<uint32_t>(data.constData(), 4);
+    header.vertex_count = readAt<uint32_t>(data.constData(), 8);
+    header.triangle_count = readAt<uint32_t>(data.constData(), 12);
+    if (header.vertex_count == 0 || header.vertex_count > uint32_t(INT_MAX / 3) ||
+        header.triangle_count > uint32_t(INT_MAX / 3))
+    {
+        setError(error, "invalid binary mesh counts");
+        return false;
+    }
+
+    const uint64_t vertices = header.vertex_count;
+    uint64_t size = HEADER_SIZE + vertices * 3 * sizeof(float) +
+                    uint64_t(header.triangle_count) * 3 * sizeof(uint32_t);
+    if ((header.flags & HAS_NORMALS) != 0)
+    {
+        size += vertices * 3 * sizeof(float);
+    }
+    if ((header.flags & HAS_COLORS) != 0)
+    {
+        size += vertices * 4;
+    }
+    if (size != uint64_t(data.size()))
+    {
+        setError(error, "binary mesh size does not match its header");
+        return false;
+    }
+    return true;
+}
+
+bool OccBinaryMesh::read(const QByteArray &data, Handle(Poly_Triangulation) & triangulation,
+                         Handle(TColStd_HArray1OfInteger) & colors, std::string *error)
+{
+    Header header;
+    if (!readHeader(data, header, error))
+    {
+        return false;
+    }
+    if (header.triangle_count == 0)
+    {
+        setError(error, "binary mesh has no triangles");
+        return false;
+    }
+
+    const char *bytes = data.constData();
+    Handle(Poly_Triangulation) result =
+        new Poly_Triangulation(int(header.vertex_count), int(header.triangle_count), false,
+                               (header.flags & HAS_NORMALS) != 0);
+    size_t offset = HEADER_SIZE + size_t(header.vertex_count) * 3 * sizeof(float);
+    for (int i = 1; i <= int(header.triangle_count); ++i)
+    {
+        uint32_t nodes[3];
+        std::memcpy(nodes, bytes + offset, sizeof(nodes));
+        offset += sizeof(nodes);
+        if (nodes[0] >= header.vertex_count || nodes[1] >= header.vertex_count ||
+            nodes[2] >= header.vertex_count)
+        {
+            setError(error, "binary mesh index out of range");
+            return false;
+        }
+        result->SetTriangle(i, Poly_Triangle(int(nodes[0]) + 1, int(nodes[1]) + 1,
+                                             int(nodes[2]) + 1));
+    }
+
+    colors.Nullify();
+    copyVertices(bytes, header, result, colors);
+    triangulation = result;
+    return true;
+}
+
+bool OccBinaryMesh::readVertices(const QByteArray &data,
+                                 const Handle(Poly_Triangulation) & triangulation,
+                                 Handle(TColStd_HArray1OfInteger) & colors,
+                                 std::string *error)
+{
+    Header header;
+    if (!readHeader(data, header, error))
+    {
+        return false;
+    }
+    if (triangulation.IsNull() || int(header.vertex_count) != triangulation->NbNodes() ||
+        header.triangle_count != 0)
+    {
+        setError(error, "vertex update does not match the mesh");
+        return false;
+    }
+
+    copyVertices(data.constData(), header, triangulation, colors);
+    return true;
+}
+
+} // namespace geotoys
@@ -0,0 +1,62 @@
+#ifndef OCCBINARYMESH_H
+#define OCCBINARYMESH_H
+
+#include <cstdint>
+#include <string>
+
+#include <QByteArray>
+
+#include <Poly_Triangulation.hxx>
+#include <TColStd_HArray1OfInteger.hxx>
+
+namespace geotoys
+{
+
+// Compact triangle mesh as passed from QML (ArrayBuffer) or C++ (QByteArray),
+// little endian, no padding:
+//   char     magic[4]        "OCCM"
+//   uint32   flags           HAS_NORMALS | HAS_COLORS
+//   uint32   vertex_count
+//   uint32   triangle_count  0 for a vertex data update
+//   float32  positions[3 * vertex_count]
+//   uint32   indices[3 * triangle_count], zero based
+//   float32  normals[3 * vertex_count]    with HAS_NORMALS
+//   uint8    colors[4 * vertex_count]     RGBA, with HAS_COLORS
+// The arrays are copied once, straight into the OCCT triangulation.
+class OccBinaryMesh
+{
+public:
+    enum Flags : uint32_t
+    {
+        HAS_NORMALS = 0x1,
+        HAS_COLORS = 0x2
+    };
+
+    struct Header
+    {
+        uint32_t flags = 0;
+        uint32_t vertex_count = 0;
+        uint32_t triangle_count = 0;
+    };
+
+    // Checks the magic and that the size matches the header
+    static bool readHeader(const QByteArray &data, Header &header,
+                           std::string *error = nullptr);
+
+    // New triangulation, normals are computed when not given. colors is
+    // null without HAS_COLORS, otherwise packed for AIS_Triangulation.
+    static bool read(const QByteArray &data, Handle(Poly_Triangulation) & triangulation,
+                     Handle(TColStd_HArray1OfInteger) & colors,
+                     std::string *error = nullptr);
+
+    // Overwrites positions, and normals or colors when present, of an
+    // existing triangulation with the same vertex count. Triangles are kept.
+    static bool readVertices(const QByteArray &data,
+                             const Handle(Poly_Triangulation) & triangulation,
+                             Handle(TColStd_HArray1OfInteger) & colors,
+                             std::string *error = nullptr);
+};
+
+} // namespace geotoys
+
+#endif // OCCBINARYMESH_H
@@ -0,0 +1,35 @@
+#include "OccCommandQueue.h"
+
+namespace geotoys
+{
+
+void OccCommandQueue::push(OccSceneCommand command)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    back_.push_back(std::move(command));
+}
+
+bool OccCommandQueue::isEmpty() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return back_.empty();
+}
+
+size_t OccCommandQueue::drain(OCCRenderer &renderer)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        front_.swap(back_);
+    }
+
+    const size_t count = front_.size();
+    for (OccSceneCommand &command : front_)
+    {
+        command(renderer);
+    }
+    // keep the capacity for the next frame
+    front_.clear();
+    return count;
+}
+
+} // namespace geotoys
@@ -0,0 +1,41 @@
+#ifndef OCCCOMMANDQUEUE_H
+#define OCCCOMMANDQUEUE_H
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace geotoys
+{
+
+class OCCRenderer;
+
+// Scene mutation recorded on the GUI thread and executed on the render thread
+using OccSceneCommand = std::function<void(OCCRenderer &renderer)>;
+
+// Double-buffered queue: producers append to the back buffer under a short
+// lock, the render thread swaps the buffers once per frame and executes the
+// commands without holding the lock.
+class OccCommandQueue
+{
+public:
+    OccCommandQueue() = default;
+
+    OccCommandQueue(const OccCommandQueue &) = delete;
+    OccCommandQueue &operator=(const OccCommandQueue &) = delete;
+
+    void push(OccSceneCommand command);
+    bool isEmpty() const;
+
+    // Run all queued commands in submission order, returns the number executed
+    size_t drain(OCCRenderer &renderer);
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<OccSceneCommand> back_;
+    std::vector<OccSceneCommand> front_;
+};
+
+} // namespace geotoys
+
+#endif // OCCCOMMANDQUEUE_H
@@ -0,0 +1,229 @@
+#include "OccFileLoader.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QThread>
+
+#include <ShapeFix_Shape.hxx>
+
+#include "OccLog.h"
+#include "OccShapeIO.h"
+#include "OccTrace.h"
+
+namespace geotoys
+{
+
+OccFileLoader::OccFileLoader(Sink sink, QObject *parent)
+    : QObject(parent)
+    , sink_(std::move(sink))
+{
+}
+
+OccFileLoader::~OccFileLoader()
+{
+    ++generation_;
+    pool_.clear();
+    pool_.waitForDone();
+}
+
+void OccFileLoader::setSettings(const OccFileLoadSettings &settings)
+{
+    settings_ = settings;
+}
+
+bool OccFileLoader::load(const QStringList &paths, const QString &idPrefix)
+{
+    if (isLoading())
+    {
+        return false;
+    }
+    if (paths.isEmpty())
+    {
+        Q_EMIT finished(0, 0, 0.0);
+        return true;
+    }
+
+    const int threads =
+        settings_.threads > 0 ? settings_.threads : std::max(QThread::idealThreadCount(), 1);
+    pool_.setMaxThreadCount(threads);
+
+    QHash<QString, int> names;
+    files_.reserve(paths.size());
+    for (const QString &path : paths)
+    {
+        const QFileInfo info(path);
+        File file;
+        file.path = path;
+        file.id = idPrefix.isEmpty() ? info.completeBaseName()
+                                     : idPrefix + '/' + info.completeBaseName();
+        const int count = names[file.id]++;
+        if (count > 0)
+        {
+            file.id += ':' + QString::number(count);
+        }
+        file.bytes = uint64_t(std::max<qint64>(info.size(), 0));
+        files_.push_back(std::move(file));
+    }
+
+    ++generation_;
+    timer_.start();
+    qCDebug(lcOccScene) << "Loading" << files_.size() << "files with" << threads
+                        << "threads";
+    startReads();
+    return true;
+}
+
+void OccFileLoader::cancel()
+{
+    ++generation_;
+    pool_.clear();
+    files_.clear();
+    next_file_ = 0;
+    bytes_in_flight_ = 0;
+    files_in_flight_ = 0;
+    done_ = 0;
+    failed_ = 0;
+    waiting_.clear();
+    batch_.clear();
+}
+
+void OccFileLoader::shapeReady(const QString &id)
+{
+    resolveWaiting(id, true);
+}
+
+void OccFileLoader::shapeFailed(const QString &id)
+{
+    resolveWaiting(id, false);
+}
+
+void OccFileLoader::shapeCancelled(const QString &id)
+{
+    resolveWaiting(id, true);
+}
+
+void OccFileLoader::resolveWaiting(const QString &id, bool ok)
+{
+    auto it = waiting_.find(id);
+    if (it == waiting_.end())
+    {
+        return;
+    }
+    const int index = it.value();
+    waiting_.erase(it);
+    fileDone(index, ok);
+}
+
+void OccFileLoader::startReads()
+{
+    while (next_file_ < files_.size())
+    {
+        File &file = files_[next_file_];
+        if (files_in_flight_ > 0 &&
+            bytes_in_flight_ + file.bytes > settings_.max_bytes_in_flight)
+        {
+            // backpressure, continued by fileDone()
+            break;
+        }
+
+        const int index = static_cast<int>(next_file_++);
+        bytes_in_flight_ += file.bytes;
+        ++files_in_flight_;
+
+        pool_.start([this, index, path = file.path, id = file.id.toStdString(),
+                     heal = settings_.heal, generation = generation_]() {
+            OCC_TRACE_SCOPE("io", "OccFileLoader::read");
+            OccShapeDesc desc;
+            desc.id = id;
+            std::string error;
+            desc.shape = OccShapeIO::readFile(path.toStdString(), &error);
+            const bool ok = !desc.shape.IsNull();
+            if (!ok)
+            {
+                qWarning() << "Cannot load" << path << error.c_str();
+            }
+            else if (heal)
+            {
+                OCC_TRACE_SCOPE("io", "OccFileLoader::heal");
+                ShapeFix_Shape fix(desc.shape);
+                fix.Perform();
+                desc.shape = fix.Shape();
+            }
+
+            QMetaObject::invokeMethod(
+                this,
+                [this, index, generation, desc, ok]() {
+                    readFinished(index, generation, desc, ok);
+                },
+                Qt::QueuedConnection);
+        });
+    }
+}
+
+void OccFileLoader::readFinished(int index, quint64 generation, const OccShapeDesc &desc,
+                                 bool ok)
+{
+    if (generation != generation_)
+    {
+        return;
+    }
+    if (!ok)
+    {
+        fileDone(index, false);
+        return;
+    }
+
+    waiting_.insert(files_[index].id, index);
+    batch_.push_back(desc);
+    if (!flush_queued_)
+    {
+        flush_queued_ = true;
+        QMetaObject::invokeMethod(this, &OccFileLoader::flushBatch, Qt::QueuedConnection);
+    }
+}
+
+void OccFileLoader::flushBatch()
+{
+    flush_queued_ = false;
+    if (batch_.empty())
+    {
+        return;
+    }
+    std::vector<OccShapeDesc> shapes;
+    shapes.swap(batch_);
+    sink_(shapes);
+}
+
+void OccFileLoader::fileDone(int index, bool ok)
+{
+    File &file = files_[index];
+    if (file.done)
+    {
+        return;
+    }
+    file.done = true;
+    bytes_in_flight_ -= file.bytes;
+    --files_in_flight_;
+    ++done_;
+    failed_ += ok ? 0 : 1;
+
+    const int total = static_cast<int>(files_.size());
+    Q_EMIT progress(done_, total);
+    if (done_ < total)
+    {
+        startReads();
+        return;
+    }
+
+    const int failed = failed_;
+    const double ms = double(timer_.nsecsElapsed()) / 1.0e6;
+    qCDebug(lcOccScene) << "Loaded" << total << "files in" << ms << "ms," << failed
+                        << "failed";
+    cancel();
+    Q_EMIT finished(total, failed, ms);
+}
+
+} // namespace geotoys
@@ -0,0 +1,113 @@
+#ifndef OCCFILELOADER_H
+#define OCCFILELOADER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+
+#include "OccSceneManager.h"
+
+namespace geotoys
+{
+
+struct OccFileLoadSettings
+{
+    // reader threads, 0 uses the core count and 1 is the sequential baseline
+    int threads = 0;
+    // file bytes read but not yet displayed, at least one file is always
+    // allowed so that a single large file still loads
+    uint64_t max_bytes_in_flight = uint64_t(1) << 30;
+    // ShapeFix_Shape on every file before meshing
+    bool heal = true;
+};
+
+// Loads many model files into one scene. Files are read and healed on a
+// bounded worker pool, finished files are handed to the sink in batches of
+// everything that arrived within one event loop pass; the sink queues them
+// for meshing in the scene manager. A file stays in flight until its shape
+// is reported through shapeReady(), shapeFailed() or shapeCancelled(), new
+// reads only start while the bytes in flight fit the budget, which bounds
+// the peak memory.
+// Lives on the GUI thread.
+class OccFileLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Sink = std::function<void(const std::vector<OccShapeDesc> &shapes)>;
+
+    explicit OccFileLoader(Sink sink, QObject *parent = nullptr);
+    ~OccFileLoader() override;
+
+    void setSettings(const OccFileLoadSettings &settings);
+    const OccFileLoadSettings &settings() const
+    {
+        return settings_;
+    }
+
+    // Ids are idPrefix/<file base name>, made unique within the call.
+    // Returns false while a previous load is running.
+    bool load(const QStringList &paths, const QString &idPrefix);
+    void cancel();
+    bool isLoading() const
+    {
+        return !files_.empty();
+    }
+
+public Q_SLOTS:
+    void shapeReady(const QString &id);
+    // meshing failed, the file counts as failed
+    void shapeFailed(const QString &id);
+    // removed or replaced before it was displayed
+    void shapeCancelled(const QString &id);
+
+Q_SIGNALS:
+    void progress(int done, int total);
+    void finished(int files, int failed, double ms);
+
+private:
+    struct File
+    {
+        QString path;
+        QString id;
+        uint64_t bytes = 0;
+        bool done = false;
+    };
+
+    void startReads();
+    void readFinished(int index, quint64 generation, const OccShapeDesc &desc,
+                      bool ok);
+    void flushBatch();
+    void fileDone(int index, bool ok);
+    void resolveWaiting(const QString &id, bool ok);
+
+private:
+    Sink sink_;
+    OccFileLoadSettings settings_;
+    QThreadPool pool_;
+
+    std::vector<File> files_;
+    size_t next_file_ = 0;
+    uint64_t bytes_in_flight_ = 0;
+    int files_in_flight_ = 0;
+    int done_ = 0;
+    int failed_ = 0;
+    // shape id -> file index, until the shape is displayed
+    QHash<QString, int> waiting_;
+    // results of finished reads, handed to the sink together
+    std::vector<OccShapeDesc> batch_;
+    bool flush_queued_ = false;
+    // results of cancelled loads are dropped by generation
+    quint64 generation_ = 0;
+    QElapsedTimer timer_;
+};
+
+} // namespace geotoys
+
+#endif // OCCFILELOADER_H
@@ -0,0 +1,182 @@
+#include "OccFrameGrabber.h"
+
+#include <QOpenGLContext>
+
+namespace geotoys
+{
+
+OccFrameGrabber::~OccFrameGrabber()
+{
+    release();
+}
+
+QOpenGLExtraFunctions *OccFrameGrabber::functions() const
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    return context != nullptr ? context->extraFunctions() : nullptr;
+}
+
+bool OccFrameGrabber::capture(const QRect &rect, Callback &callback)
+{
+    const QSize size = rect.size();
+    QOpenGLExtraFunctions *gl = functions();
+    if (gl == nullptr || size.isEmpty())
+    {
+        return false;
+    }
+
+    Buffer *free = nullptr;
+    for (Buffer &buffer : buffers_)
+    {
+        if (buffer.fence == nullptr)
+        {
+            free = &buffer;
+            break;
+        }
+    }
+    if (free == nullptr)
+    {
+        ++stats_.busy;
+        return false;
+    }
+
+    const size_t bytes = size_t(size.width()) * size_t(size.height()) * 4;
+    if (free->pbo == 0)
+    {
+        gl->glGenBuffers(1, &free->pbo);
+    }
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, free->pbo);
+    if (free->bytes != bytes)
+    {
+        gl->glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_READ);
+        free->bytes = bytes;
+    }
+    gl->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    gl->glReadPixels(rect.x(), rect.y(), size.width(), size.height(), GL_RGBA,
+                     GL_UNSIGNED_BYTE, nullptr);
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    free->fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // make sure the fence reaches the GPU, otherwise polling never sees it
+    gl->glFlush();
+    free->size = size;
+    free->callback = std::move(callback);
+    free->sequence = next_sequence_++;
+    free->timer.start();
+    ++stats_.captured;
+    return true;
+}
+
+int OccFrameGrabber::poll()
+{
+    QOpenGLExtraFunctions *gl = functions();
+    if (gl == nullptr)
+    {
+        return 0;
+    }
+
+    int delivered = 0;
+    for (;;)
+    {
+        // oldest pending capture first, later ones cannot have finished earlier
+        Buffer *oldest = nullptr;
+        for (Buffer &buffer : buffers_)
+        {
+            if (buffer.fence != nullptr &&
+                (oldest == nullptr || buffer.sequence < oldest->sequence))
+            {
+                oldest = &buffer;
+            }
+        }
+        if (oldest == nullptr)
+        {
+            break;
+        }
+        const GLenum status = gl->glClientWaitSync(oldest->fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            break;
+        }
+        gl->glDeleteSync(oldest->fence);
+        oldest->fence = nullptr;
+
+        QImage image;
+        if (status != GL_WAIT_FAILED)
+        {
+            const int width = oldest->size.width();
+            const int height = oldest->size.height();
+            gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, oldest->pbo);
+            const void *data = gl->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                                    GLsizeiptr(oldest->bytes), GL_MAP_READ_BIT);
+            if (data != nullptr)
+            {
+                // mirrored() copies, the mapping is gone after unmap
+                image = QImage(static_cast<const uchar *>(data), width, height, width * 4,
+                               QImage::Format_RGBA8888)
+                            .mirrored();
+                gl->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        const double latency = oldest->timer.nsecsElapsed() / 1.0e6;
+        ++stats_.delivered;
+        stats_.last_latency_ms = latency;
+        stats_.mean_latency_ms += (latency - stats_.mean_latency_ms) / double(stats_.delivered);
+        ++delivered;
+
+        Callback callback = std::move(oldest->callback);
+        oldest->callback = nullptr;
+        if (callback)
+        {
+            callback(image, latency);
+        }
+    }
+    return delivered;
+}
+
+bool OccFrameGrabber::isBusy() const
+{
+    for (const Buffer &buffer : buffers_)
+    {
+        if (buffer.fence != nullptr)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool OccFrameGrabber::hasFreeBuffer() const
+{
+    for (const Buffer &buffer : buffers_)
+    {
+        if (buffer.fence == nullptr)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void OccFrameGrabber::release()
+{
+    QOpenGLExtraFunctions *gl = functions();
+    for (Buffer &buffer : buffers_)
+    {
+        if (gl != nullptr)
+        {
+            if (buffer.fence != nullptr)
+            {
+                gl->glDeleteSync(buffer.fence);
+            }
+            if (buffer.pbo != 0)
+            {
+                gl->glDeleteBuffers(1, &buffer.pbo);
+            }
+        }
+        buffer = Buffer();
+    }
+}
+
+} // namespace geotoys
@@ -0,0 +1,85 @@
+#ifndef OCCFRAMEGRABBER_H
+#define OCCFRAMEGRABBER_H
+
+#include <cstdint>
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QOpenGLExtraFunctions>
+#include <QRect>
+#include <QSize>
+
+namespace geotoys
+{
+
+struct OccGrabStats
+{
+    uint64_t captured = 0;
+    uint64_t delivered = 0;
+    // capture() calls without a free buffer
+    uint64_t busy = 0;
+    // from capture() to delivery
+    double last_latency_ms = 0.0;
+    double mean_latency_ms = 0.0;
+};
+
+// Non blocking readback of the bound read framebuffer through a ring of pixel
+// buffer objects. capture() queues glReadPixels into a free buffer followed
+// by a fence and returns at once, poll() maps the buffers whose fence has
+// signaled, usually one or two frames later, and hands the images over in
+// capture order. Render thread only, with the GL context current.
+class OccFrameGrabber
+{
+public:
+    static const int BUFFER_COUNT = 3;
+
+    // image is top down RGBA8888
+    using Callback = std::function<void(const QImage &image, double latencyMs)>;
+
+    OccFrameGrabber() = default;
+    ~OccFrameGrabber();
+
+    OccFrameGrabber(const OccFrameGrabber &) = delete;
+    OccFrameGrabber &operator=(const OccFrameGrabber &) = delete;
+
+    // rect in pixels of the read framebuffer, OpenGL origin. False when all
+    // buffers are waiting for the GPU, callback is only taken over on
+    // success so that the caller can retry later.
+    bool capture(const QRect &rect, Callback &callback);
+    // Never waits, returns the number of delivered images
+    int poll();
+    // some capture still waits for the GPU
+    bool isBusy() const;
+    bool hasFreeBuffer() const;
+    // Deletes the GL objects, pending captures are dropped
+    void release();
+
+    const OccGrabStats &stats() const
+    {
+        return stats_;
+    }
+
+private:
+    struct Buffer
+    {
+        GLuint pbo = 0;
+        size_t bytes = 0;
+        GLsync fence = nullptr;
+        QSize size;
+        Callback callback;
+        uint64_t sequence = 0;
+        QElapsedTimer timer;
+    };
+
+    QOpenGLExtraFunctions *functions() const;
+
+private:
+    Buffer buffers_[BUFFER_COUNT];
+    uint64_t next_sequence_ = 0;
+    OccGrabStats stats_;
+};
+
+} // namespace geotoys
+
+#endif // OCCFRAMEGRABBER_H
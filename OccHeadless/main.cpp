@@ -0,0 +1,312 @@
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QSurfaceFormat>
+#include <QTextStream>
+
+#include <TopoDS_Shape.hxx>
+#include <V3d_TypeOfOrientation.hxx>
+#include <V3d_View.hxx>
+
+#include "OCCRenderer.h"
+#include "OccMeshCache.h"
+#include "OccSceneManager.h"
+#include "OccShapeIO.h"
+
+using namespace geotoys;
+
+// Renders PNG snapshots of model files without a window. One GL context,
+// FBO and OCCT viewer are created up front and reused for every job.
+//
+// OCCT builds for X11 still open a display connection, run under Xvfb on
+// machines without a display:
+//   xvfb-run -a OccHeadless -o out -v iso,front,top models/*.step
+namespace
+{
+struct CameraPreset
+{
+    const char *name;
+    V3d_TypeOfOrientation orientation;
+};
+
+const CameraPreset CAMERA_PRESETS[] = {
+    {"iso", V3d_TypeOfOrientation_Zup_AxoRight},
+    {"front", V3d_TypeOfOrientation_Zup_Front},
+    {"back", V3d_TypeOfOrientation_Zup_Back},
+    {"top", V3d_TypeOfOrientation_Zup_Top},
+    {"bottom", V3d_TypeOfOrientation_Zup_Bottom},
+    {"left", V3d_TypeOfOrientation_Zup_Left},
+    {"right", V3d_TypeOfOrientation_Zup_Right},
+};
+
+const CameraPreset *findPreset(const QString &name)
+{
+    for (const CameraPreset &preset : CAMERA_PRESETS)
+    {
+        if (name == QLatin1String(preset.name))
+        {
+            return &preset;
+        }
+    }
+    return nullptr;
+}
+
+bool parseSize(const QString &text, QSize &size)
+{
+    const QStringList parts = text.toLower().split('x');
+    if (parts.size() != 2)
+    {
+        return false;
+    }
+    bool okW = false;
+    bool okH = false;
+    size = QSize(parts[0].toInt(&okW), parts[1].toInt(&okH));
+    return okW && okH && size.width() > 0 && size.height() > 0;
+}
+
+// One model path per line, empty lines and # comments are skipped
+QStringList readModelList(const QString &path)
+{
+    QStringList models;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        std::cerr << "Cannot open model list " << path.toStdString() << std::endl;
+        return models;
+    }
+    QTextStream stream(&file);
+    while (!stream.atEnd())
+    {
+        const QString line = stream.readLine().trimmed();
+        if (!line.isEmpty() && !line.startsWith('#'))
+        {
+            models << line;
+        }
+    }
+    return models;
+}
+
+struct LoadedModel
+{
+    TopoDS_Shape shape;
+    std::string error;
+    double read_ms = 0.0;
+};
+
+std::future<LoadedModel> readModelAsync(const QString &path)
+{
+    return std::async(std::launch::async, [path]() {
+        QElapsedTimer timer;
+        timer.start();
+        LoadedModel model;
+        model.shape = OccShapeIO::readFile(path.toStdString(), &model.error);
+        model.read_ms = double(timer.nsecsElapsed()) / 1.0e6;
+        return model;
+    });
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QSurfaceFormat aGlFormat;
+    aGlFormat.setDepthBufferSize(24);
+    aGlFormat.setStencilBufferSize(8);
+#if defined(_WIN32)
+    aGlFormat.setVersion(4, 5);
+    aGlFormat.setProfile(QSurfaceFormat::CoreProfile);
+#else
+    aGlFormat.setVersion(3, 3);
+    aGlFormat.setProfile(QSurfaceFormat::CompatibilityProfile);
+#endif
+    QSurfaceFormat::setDefaultFormat(aGlFormat);
+
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Render PNG snapshots of model files offscreen");
+    parser.addHelpOption();
+    QCommandLineOption outputOption({"o", "output"}, "Output directory.", "dir", ".");
+    QCommandLineOption sizeOption({"s", "size"}, "Image size.", "WxH", "512x512");
+    QCommandLineOption viewsOption(
+        {"v", "views"},
+        "Comma separated camera presets: iso, front, back, top, bottom, left, right.",
+        "list", "iso");
+    QCommandLineOption listOption({"l", "list"}, "File with one model path per line.",
+                                  "file");
+    QCommandLineOption cacheOption("mesh-cache", "Triangulation cache directory.", "dir");
+    parser.addOptions({outputOption, sizeOption, viewsOption, listOption, cacheOption});
+    parser.addPositionalArgument("models", "BRep, STEP or IGES files.", "[models...]");
+    parser.process(app);
+
+    QStringList models = parser.positionalArguments();
+    if (parser.isSet(listOption))
+    {
+        models << readModelList(parser.value(listOption));
+    }
+    if (models.isEmpty())
+    {
+        parser.showHelp(1);
+    }
+
+    QSize imageSize;
+    if (!parseSize(parser.value(sizeOption), imageSize))
+    {
+        std::cerr << "Invalid image size " << parser.value(sizeOption).toStdString()
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<const CameraPreset *> presets;
+    for (const QString &name : parser.value(viewsOption).split(',', Qt::SkipEmptyParts))
+    {
+        const CameraPreset *preset = findPreset(name.trimmed());
+        if (!preset)
+        {
+            std::cerr << "Unknown camera preset " << name.toStdString() << std::endl;
+            return 1;
+        }
+        presets.push_back(preset);
+    }
+
+    const QDir outputDir(parser.value(outputOption));
+    if (!outputDir.mkpath("."))
+    {
+        std::cerr << "Cannot create output directory "
+                  << outputDir.path().toStdString() << std::endl;
+        return 1;
+    }
+
+    QOpenGLContext glContext;
+    glContext.setFormat(aGlFormat);
+    if (!glContext.create())
+    {
+        std::cerr << "Cannot create OpenGL context" << std::endl;
+        return 1;
+    }
+    QOffscreenSurface surface;
+    surface.setFormat(glContext.format());
+    surface.create();
+    if (!glContext.makeCurrent(&surface))
+    {
+        std::cerr << "Cannot make OpenGL context current" << std::endl;
+        return 1;
+    }
+
+    int failures = 0;
+    int images = 0;
+    double renderMs = 0.0;
+    QElapsedTimer totalTimer;
+    totalTimer.start();
+    {
+        // the renderer owns the OCCT viewer, the FBO is created by it the
+        // same way QQuickFramebufferObject does
+        auto renderer = std::make_unique<OCCRenderer>(nullptr);
+        std::unique_ptr<QOpenGLFramebufferObject> fbo(
+            renderer->createFramebufferObject(imageSize));
+        renderer->setDecorationsVisible(false);
+
+        OccSceneManager *scene = renderer->getSceneManager();
+        OccMeshParameters meshParams;
+        // a single fixed camera per image, coarser levels would be wasted
+        meshParams.lod_levels = 1;
+        scene->setMeshParameters(meshParams);
+        if (parser.isSet(cacheOption))
+        {
+            scene->setMeshCache(std::make_shared<OccMeshCache>(
+                parser.value(cacheOption).toStdString(), uint64_t(1) << 30));
+        }
+        const Handle(V3d_View) &view = renderer->getView();
+
+        std::future<LoadedModel> next = readModelAsync(models.front());
+        for (int index = 0; index < models.size(); ++index)
+        {
+            const QString path = models[index];
+            LoadedModel model = next.get();
+            if (index + 1 < models.size())
+            {
+                next = readModelAsync(models[index + 1]);
+            }
+
+            if (model.shape.IsNull())
+            {
+                std::cerr << model.error << std::endl;
+                ++failures;
+                continue;
+            }
+
+            QElapsedTimer jobTimer;
+            jobTimer.start();
+            scene->clearAllShapes();
+            scene->addShape("model", model.shape, Quantity_NOC_YELLOW, true);
+            const double meshMs = double(jobTimer.nsecsElapsed()) / 1.0e6;
+
+            const QString baseName = QFileInfo(path).completeBaseName();
+            for (const CameraPreset *preset : presets)
+            {
+                QElapsedTimer imageTimer;
+                imageTimer.start();
+
+                view->SetProj(preset->orientation);
+                view->FitAll(0.01, false);
+                view->ZFitAll();
+                view->Invalidate();
+
+                fbo->bind();
+                renderer->render();
+                const QImage image = fbo->toImage().convertToFormat(QImage::Format_RGB32);
+                fbo->release();
+
+                const QString imagePath =
+                    outputDir.filePath(baseName + "_" + preset->name + ".png");
+                if (!image.save(imagePath))
+                {
+                    std::cerr << "Cannot write " << imagePath.toStdString() << std::endl;
+                    ++failures;
+                    continue;
+                }
+                renderMs += double(imageTimer.nsecsElapsed()) / 1.0e6;
+                ++images;
+            }
+
+            std::cout << path.toStdString() << ": read " << model.read_ms
+                      << " ms, mesh " << meshMs << " ms, "
+                      << presets.size() << " images in "
+                      << double(jobTimer.nsecsElapsed()) / 1.0e6 << " ms" << std::endl;
+        }
+
+        scene->clearAllShapes();
+        fbo.reset();
+        renderer.reset();
+    }
+    glContext.doneCurrent();
+
+    const double totalSec = double(totalTimer.nsecsElapsed()) / 1.0e9;
+    std::cout << images << " images in " << totalSec << " s, "
+              << (totalSec > 0.0 ? images / totalSec : 0.0) << " images/s overall, "
+              << (renderMs > 0.0 ? images * 1000.0 / renderMs : 0.0)
+              << " images/s render and readback" << std::endl;
+    if (failures > 0)
+    {
+        std::cerr << failures << " jobs failed" << std::endl;
+    }
+    return failures > 0 ? 1 : 0;
+}
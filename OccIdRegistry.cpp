@@ -0,0 +1,232 @@
+#include "OccIdRegistry.h"
+
+namespace geotoys
+{
+
+namespace
+{
+const std::string EMPTY_KEY;
+} // namespace
+
+bool OccIdRegistry::insert(const QString &id)
+{
+    if (index_.contains(id))
+    {
+        return false;
+    }
+
+    uint32_t slot = 0;
+    if (free_slots_.empty())
+    {
+        slot = static_cast<uint32_t>(slots_.size());
+        slots_.emplace_back();
+    }
+    else
+    {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    slots_[slot].id = id;
+    slots_[slot].key = id.toStdString();
+    index_.insert(id, slot);
+    addToGroup(parentPath(id), slot);
+    recordChange(id, 1);
+    return true;
+}
+
+bool OccIdRegistry::remove(const QString &id)
+{
+    auto it = index_.find(id);
+    if (it == index_.end())
+    {
+        return false;
+    }
+
+    const uint32_t slot = it.value();
+    index_.erase(it);
+    removeFromGroup(parentPath(id), slot);
+    recordChange(id, -1);
+    slots_[slot] = Slot();
+    free_slots_.push_back(slot);
+    return true;
+}
+
+const std::string &OccIdRegistry::key(const QString &id) const
+{
+    auto it = index_.constFind(id);
+    return it == index_.constEnd() ? EMPTY_KEY : slots_[it.value()].key;
+}
+
+void OccIdRegistry::setMeshVertices(const QString &id, uint32_t count)
+{
+    auto it = index_.constFind(id);
+    if (it != index_.constEnd())
+    {
+        slots_[it.value()].mesh_vertices = count;
+    }
+}
+
+uint32_t OccIdRegistry::meshVertices(const QString &id) const
+{
+    auto it = index_.constFind(id);
+    return it == index_.constEnd() ? 0 : slots_[it.value()].mesh_vertices;
+}
+
+QStringList OccIdRegistry::ids() const
+{
+    QStringList result;
+    result.reserve(index_.size());
+    for (auto it = index_.constBegin(); it != index_.constEnd(); ++it)
+    {
+        result.append(it.key());
+    }
+    return result;
+}
+
+QStringList OccIdRegistry::idsUnder(const QString &prefix) const
+{
+    QStringList result;
+    visitUnder(prefix, [&](const Slot &slot) { result.append(slot.id); });
+    return result;
+}
+
+std::vector<std::string> OccIdRegistry::keysUnder(const QString &prefix) const
+{
+    std::vector<std::string> result;
+    visitUnder(prefix, [&](const Slot &slot) { result.push_back(slot.key); });
+    return result;
+}
+
+void OccIdRegistry::clear()
+{
+    slots_.clear();
+    free_slots_.clear();
+    index_.clear();
+    groups_.clear();
+    changes_.clear();
+    reset_ = true;
+}
+
+void OccIdRegistry::takeChanges(QStringList &added, QStringList &removed, bool &reset)
+{
+    added.clear();
+    removed.clear();
+    for (auto it = changes_.constBegin(); it != changes_.constEnd(); ++it)
+    {
+        (it.value() > 0 ? added : removed).append(it.key());
+    }
+    reset = reset_;
+    changes_.clear();
+    reset_ = false;
+}
+
+QString OccIdRegistry::groupPath(const QString &prefix)
+{
+    QString path = prefix;
+    while (path.endsWith('/'))
+    {
+        path.chop(1);
+    }
+    return path;
+}
+
+QString OccIdRegistry::parentPath(const QString &path)
+{
+    const qsizetype slash = path.lastIndexOf('/');
+    return slash < 0 ? QString() : path.left(slash);
+}
+
+void OccIdRegistry::addToGroup(const QString &path, uint32_t slot)
+{
+    groups_[path].members.insert(slot);
+
+    // link the new groups up to the first one already known
+    QString child = path;
+    while (!child.isEmpty())
+    {
+        const QString parent = parentPath(child);
+        Group &group = groups_[parent];
+        if (group.children.contains(child))
+        {
+            break;
+        }
+        group.children.insert(child);
+        child = parent;
+    }
+}
+
+void OccIdRegistry::removeFromGroup(const QString &path, uint32_t slot)
+{
+    auto it = groups_.find(path);
+    if (it == groups_.end())
+    {
+        return;
+    }
+    it->members.remove(slot);
+
+    // drop groups left empty, the root stays
+    QString current = path;
+    while (!current.isEmpty())
+    {
+        auto groupIt = groups_.find(current);
+        if (groupIt == groups_.end() || !groupIt->members.isEmpty() ||
+            !groupIt->children.isEmpty())
+        {
+            break;
+        }
+        groups_.erase(groupIt);
+        const QString parent = parentPath(current);
+        auto parentIt = groups_.find(parent);
+        if (parentIt != groups_.end())
+        {
+            parentIt->children.remove(current);
+        }
+        current = parent;
+    }
+}
+
+template <typename Visitor>
+void OccIdRegistry::visitUnder(const QString &prefix, Visitor visitor) const
+{
+    const QString path = groupPath(prefix);
+    auto idIt = index_.constFind(path);
+    if (idIt != index_.constEnd())
+    {
+        visitor(slots_[idIt.value()]);
+    }
+
+    QStringList stack{path};
+    while (!stack.isEmpty())
+    {
+        auto it = groups_.constFind(stack.takeLast());
+        if (it == groups_.constEnd())
+        {
+            continue;
+        }
+        for (uint32_t slot : it->members)
+        {
+            visitor(slots_[slot]);
+        }
+        for (const QString &child : it->children)
+        {
+            stack.append(child);
+        }
+    }
+}
+
+void OccIdRegistry::recordChange(const QString &id, int delta)
+{
+    auto it = changes_.find(id);
+    if (it == changes_.end())
+    {
+        changes_.insert(id, delta);
+        return;
+    }
+    it.value() += delta;
+    if (it.value() == 0)
+    {
+        changes_.erase(it);
+    }
+}
+
+} // namespace geotoys
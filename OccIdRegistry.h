@@ -0,0 +1,94 @@
+#ifndef OCCIDREGISTRY_H
+#define OCCIDREGISTRY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+namespace geotoys
+{
+
+// GUI side registry of the scene ids. Every id is interned once together
+// with its UTF-8 copy for the render thread, lookups are hashed. Ids form a
+// hierarchy on '/' ("assembly/sub1/bolt"), each path prefix is a group so
+// that everything below a prefix is found without scanning the scene.
+// Inserts and removals are collected until takeChanges() so observers get
+// deltas instead of full id lists.
+class OccIdRegistry
+{
+public:
+    bool insert(const QString &id);
+    bool remove(const QString &id);
+    bool contains(const QString &id) const
+    {
+        return index_.contains(id);
+    }
+    // interned UTF-8 id, empty for unknown ids
+    const std::string &key(const QString &id) const;
+    // vertex count of an id added as a mesh, 0 for BRep shapes and unknown
+    // ids. Lets vertex only updates be checked without the render thread.
+    void setMeshVertices(const QString &id, uint32_t count);
+    uint32_t meshVertices(const QString &id) const;
+
+    int size() const
+    {
+        return static_cast<int>(index_.size());
+    }
+    QStringList ids() const;
+    // the id equal to prefix and all ids below prefix + '/'
+    QStringList idsUnder(const QString &prefix) const;
+    std::vector<std::string> keysUnder(const QString &prefix) const;
+    // prefix without trailing '/', the path of its group
+    static QString groupPath(const QString &prefix);
+    void clear();
+
+    bool hasChanges() const
+    {
+        return reset_ || !changes_.isEmpty();
+    }
+    // Net changes since the last call, reset means all ids known before
+    // were removed
+    void takeChanges(QStringList &added, QStringList &removed, bool &reset);
+
+private:
+    struct Slot
+    {
+        QString id;
+        std::string key;
+        uint32_t mesh_vertices = 0;
+    };
+
+    struct Group
+    {
+        // slots of the ids directly in this group
+        QSet<uint32_t> members;
+        QSet<QString> children;
+    };
+
+    static QString parentPath(const QString &path);
+    void addToGroup(const QString &path, uint32_t slot);
+    void removeFromGroup(const QString &path, uint32_t slot);
+    template <typename Visitor>
+    void visitUnder(const QString &prefix, Visitor visitor) const;
+    void recordChange(const QString &id, int delta);
+
+private:
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> free_slots_;
+    QHash<QString, uint32_t> index_;
+    // keyed by path without the trailing '/', "" is the root
+    QHash<QString, Group> groups_;
+
+    // +1 added, -1 removed since the last takeChanges()
+    QHash<QString, int> changes_;
+    bool reset_ = false;
+};
+
+} // namespace geotoys
+
+#endif // OCCIDREGISTRY_H
@@ -0,0 +1,38 @@
+#include "OccInputQueue.h"
+
+#include <utility>
+
+namespace geotoys
+{
+
+void OccInputQueue::push(const OccInputEvent &event)
+{
+    if (!events_.empty())
+    {
+        OccInputEvent &last = events_.back();
+        const bool isPosition =
+            event.type == OccInputEvent::Type::Move || event.type == OccInputEvent::Type::Hover;
+        if (isPosition && last.type == event.type && last.modifiers == event.modifiers)
+        {
+            last.position = event.position;
+            return;
+        }
+        if (event.type == OccInputEvent::Type::Wheel && last.type == event.type &&
+            last.modifiers == event.modifiers)
+        {
+            last.position = event.position;
+            last.wheel_delta += event.wheel_delta;
+            return;
+        }
+    }
+    events_.push_back(event);
+}
+
+std::vector<OccInputEvent> OccInputQueue::take()
+{
+    std::vector<OccInputEvent> events;
+    events.swap(events_);
+    return events;
+}
+
+} // namespace geotoys
@@ -0,0 +1,57 @@
+#ifndef OCCINPUTQUEUE_H
+#define OCCINPUTQUEUE_H
+
+#include <vector>
+
+#include <QPointF>
+#include <QtCore/qnamespace.h>
+
+namespace geotoys
+{
+
+struct OccInputEvent
+{
+    enum class Type
+    {
+        Press,
+        Release,
+        Move,
+        Hover,
+        Wheel
+    };
+
+    Type type = Type::Move;
+    // item coordinates in logical pixels
+    QPointF position;
+    // the changed button for Press, the buttons still held for Release
+    Qt::MouseButtons buttons;
+    Qt::KeyboardModifiers modifiers;
+    // accumulated wheel rotation in degrees
+    double wheel_delta = 0.0;
+};
+
+// Pointer input recorded by the item between two frames. Consecutive moves
+// keep only the latest position and consecutive wheel steps are summed, so
+// the renderer applies at most one position update per frame between button
+// transitions. Button transitions are never merged or dropped.
+// Filled on the GUI thread and taken in synchronize() while it is blocked,
+// hence no locking.
+class OccInputQueue
+{
+public:
+    void push(const OccInputEvent &event);
+
+    bool isEmpty() const
+    {
+        return events_.empty();
+    }
+
+    std::vector<OccInputEvent> take();
+
+private:
+    std::vector<OccInputEvent> events_;
+};
+
+} // namespace geotoys
+
+#endif // OCCINPUTQUEUE_H
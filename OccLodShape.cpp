@@ -0,0 +1,228 @@
+#include "OccLodShape.h"
+
+#include <algorithm>
+
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <Graphic3d_Group.hxx>
+#include <Prs3d_Presentation.hxx>
+#include <Prs3d_ShadingAspect.hxx>
+#include <PrsMgr_PresentationManager.hxx>
+#include <StdPrs_ShadedShape.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
+
+namespace geotoys
+{
+
+IMPLEMENT_STANDARD_RTTIEXT(OccLodShape, AIS_Shape)
+IMPLEMENT_STANDARD_RTTIEXT(OccLodInstance, AIS_ConnectedInteractive)
+
+OccLodShape::OccLodShape(const TopoDS_Shape &shape, double deflection)
+    : AIS_Shape(shape)
+    , source_(shape)
+{
+    clearLevels(deflection);
+}
+
+void OccLodShape::addLevel(const TopoDS_Shape &shape, double deflection)
+{
+    level_shapes_.push_back(shape);
+    level_deflections_.push_back(deflection);
+}
+
+void OccLodShape::clearLevels(double deflection)
+{
+    level_shapes_.assign(1, TopoDS_Shape());
+    level_deflections_.assign(1, deflection);
+    active_level_ = 0;
+}
+
+void OccLodShape::adoptSelection(const Handle(SelectMgr_Selection) & theSelection)
+{
+    AddSelection(theSelection, theSelection->Mode());
+}
+
+Standard_Boolean OccLodShape::AcceptDisplayMode(const Standard_Integer theMode) const
+{
+    if (theMode > LOD_MODE_BASE)
+    {
+        return theMode - LOD_MODE_BASE < nbLevels();
+    }
+    return AIS_Shape::AcceptDisplayMode(theMode);
+}
+
+void OccLodShape::Compute(const Handle(PrsMgr_PresentationManager) & thePrsMgr,
+                          const Handle(Prs3d_Presentation) & thePrs,
+                          const Standard_Integer theMode)
+{
+    int level = -1;
+    if (theMode == AIS_Shaded)
+    {
+        level = 0;
+    }
+    else if (theMode > LOD_MODE_BASE && theMode - LOD_MODE_BASE < nbLevels())
+    {
+        level = theMode - LOD_MODE_BASE;
+    }
+    if (level < 0)
+    {
+        AIS_Shape::Compute(thePrsMgr, thePrs, theMode);
+        return;
+    }
+
+    if (!myDrawer->FaceBoundaryDraw() && !myDrawer->IsAutoTriangulation() &&
+        !levelShape(level).IsNull())
+    {
+        // triangulated by the mesh pipeline, see computeShaded()
+        computeShaded(thePrs, level);
+        return;
+    }
+    if (level == 0)
+    {
+        AIS_Shape::Compute(thePrsMgr, thePrs, theMode);
+        return;
+    }
+
+    // the copy is triangulated by the mesh pipeline, never mesh here
+    StdPrs_ShadedShape::Add(thePrs, level_shapes_[level], myDrawer);
+}
+
+void OccLodShape::computeShaded(const Handle(Prs3d_Presentation) & thePrs, int level)
+{
+    const TopoDS_Shape &shape = levelShape(level);
+    // faces of closed solids get their own groups, like StdPrs_ShadedShape,
+    // so that back faces can be culled and sections capped
+    std::vector<TopoDS_Face> closedFaces;
+    std::vector<TopoDS_Face> openFaces;
+    for (TopExp_Explorer solidIt(shape, TopAbs_SOLID); solidIt.More(); solidIt.Next())
+    {
+        std::vector<TopoDS_Face> &faces =
+            BRep_Tool::IsClosed(solidIt.Current()) ? closedFaces : openFaces;
+        for (TopExp_Explorer exp(solidIt.Current(), TopAbs_FACE); exp.More(); exp.Next())
+        {
+            faces.push_back(TopoDS::Face(exp.Current()));
+        }
+    }
+    for (TopExp_Explorer exp(shape, TopAbs_FACE, TopAbs_SOLID); exp.More(); exp.Next())
+    {
+        openFaces.push_back(TopoDS::Face(exp.Current()));
+    }
+
+    if (level >= int(level_chunks_.size()))
+    {
+        level_chunks_.resize(size_t(level) + 1);
+    }
+    std::vector<ShadedChunk> &previous = level_chunks_[level];
+    std::vector<ShadedChunk> chunks;
+    int reused = appendChunks(closedFaces, true, previous, chunks);
+    reused += appendChunks(openFaces, false, previous, chunks);
+    previous.swap(chunks);
+    if (level == 0)
+    {
+        reused_chunks_ = reused;
+    }
+    addShadedGroups(thePrs, myDrawer->ShadingAspect()->Aspect(), level);
+}
+
+int OccLodShape::appendChunks(const std::vector<TopoDS_Face> &faces, bool closed,
+                              const std::vector<ShadedChunk> &previous,
+                              std::vector<ShadedChunk> &chunks)
+{
+    // a chunk is reused while its faces keep their triangulations, location
+    // and orientation: an update gives new faces sharing the triangulations
+    // of unchanged ones. Faces shifted by an added or removed face are refilled
+    int reused = 0;
+    for (size_t first = 0; first < faces.size(); first += FACES_PER_CHUNK)
+    {
+        const size_t index = chunks.size();
+        ShadedChunk &chunk = chunks.emplace_back();
+        const size_t last = std::min(first + FACES_PER_CHUNK, faces.size());
+        chunk.closed = closed;
+        chunk.faces.assign(faces.begin() + first, faces.begin() + last);
+        for (const TopoDS_Face &face : chunk.faces)
+        {
+            TopLoc_Location location;
+            chunk.triangulations.push_back(BRep_Tool::Triangulation(face, location));
+        }
+
+        if (index < previous.size() && previous[index].closed == closed &&
+            previous[index].triangulations == chunk.triangulations &&
+            std::equal(chunk.faces.begin(), chunk.faces.end(), previous[index].faces.begin(),
+                       previous[index].faces.end(),
+                       [](const TopoDS_Face &a, const TopoDS_Face &b) {
+                           return a.Orientation() == b.Orientation() &&
+                                  a.Location().IsEqual(b.Location());
+                       }))
+        {
+            chunk.triangles = previous[index].triangles;
+            ++reused;
+        }
+        else
+        {
+            BRep_Builder builder;
+            TopoDS_Compound compound;
+            builder.MakeCompound(compound);
+            for (const TopoDS_Face &face : chunk.faces)
+            {
+                builder.Add(compound, face);
+            }
+            chunk.triangles = StdPrs_ShadedShape::FillTriangles(compound);
+        }
+    }
+    return reused;
+}
+
+void OccLodShape::addShadedGroups(const Handle(Prs3d_Presentation) & thePrs,
+                                  const Handle(Graphic3d_AspectFillArea3d) & theAspect,
+                                  int level) const
+{
+    if (level >= int(level_chunks_.size()))
+    {
+        return;
+    }
+    for (const ShadedChunk &chunk : level_chunks_[level])
+    {
+        if (!chunk.triangles.IsNull())
+        {
+            Handle(Graphic3d_Group) group = thePrs->NewGroup();
+            group->SetClosed(chunk.closed);
+            group->SetGroupPrimitivesAspect(theAspect);
+            group->AddPrimitiveArray(chunk.triangles);
+        }
+    }
+
+    // edges and vertices outside faces, as drawn by StdPrs_ShadedShape
+    StdPrs_ShadedShape::AddWireframeForFreeElements(thePrs, levelShape(level), myDrawer);
+}
+
+void OccLodInstance::Compute(const Handle(PrsMgr_PresentationManager) & thePrsMgr,
+                             const Handle(Prs3d_Presentation) & thePrs,
+                             const Standard_Integer theMode)
+{
+    Handle(OccLodShape) part = Handle(OccLodShape)::DownCast(myReference);
+    if (!HasColor() || part.IsNull() || theMode != AIS_Shaded)
+    {
+        AIS_ConnectedInteractive::Compute(thePrsMgr, thePrs, theMode);
+        return;
+    }
+
+    // the arrays come from the part's presentation, compute it if needed
+    Handle(PrsMgr_Presentation) partPrs = thePrsMgr->Presentation(part, theMode, true);
+    if (partPrs->MustBeUpdated())
+    {
+        thePrsMgr->Update(part, theMode);
+    }
+
+    thePrs->Clear(false);
+    thePrs->DisconnectAll(Graphic3d_TOC_DESCENDANT);
+    Quantity_Color color;
+    Color(color);
+    Handle(Prs3d_ShadingAspect) shading = new Prs3d_ShadingAspect(
+        new Graphic3d_AspectFillArea3d(*part->Attributes()->ShadingAspect()->Aspect()));
+    shading->SetColor(color);
+    part->addShadedGroups(thePrs, shading->Aspect());
+}
+
+} // namespace geotoys
@@ -0,0 +1,154 @@
+#ifndef OCCLODSHAPE_H
+#define OCCLODSHAPE_H
+
+#include <vector>
+
+#include <AIS_ConnectedInteractive.hxx>
+#include <AIS_Shape.hxx>
+#include <Graphic3d_ArrayOfTriangles.hxx>
+#include <Graphic3d_AspectFillArea3d.hxx>
+#include <Poly_Triangulation.hxx>
+#include <SelectMgr_Selection.hxx>
+#include <TopoDS_Face.hxx>
+#include <TopoDS_Shape.hxx>
+
+namespace geotoys
+{
+
+//! AIS_Shape keeping coarser triangulations of the same shape as extra
+//! display modes. Level 0 is the shape itself shown in AIS_Shaded mode,
+//! level N is an independently meshed copy shown in displayMode(N).
+//! Presentations of all levels stay computed, so switching the display mode
+//! only toggles structure visibility.
+//! All shapes prepared by OccMeshPipeline use this class, with a single level
+//! when level of detail is disabled.
+//! Every level is drawn as one triangle array per FACES_PER_CHUNK faces,
+//! faces of closed solids and open faces in separate chunks. A recompute
+//! after SetShape() refills only the chunks whose face triangulations
+//! changed, see OccMeshPipeline::remeshShape().
+class OccLodShape : public AIS_Shape
+{
+    DEFINE_STANDARD_RTTIEXT(OccLodShape, AIS_Shape)
+
+public:
+    static const int LOD_MODE_BASE = 100;
+    static const int FACES_PER_CHUNK = 64;
+
+    OccLodShape(const TopoDS_Shape &shape, double deflection);
+
+    //! Shape given by the caller. The mesh pipeline triangulates a topology
+    //! copy of it, which is myshape, so the caller's faces are never written.
+    const TopoDS_Shape &source() const
+    {
+        return source_;
+    }
+    void setSource(const TopoDS_Shape &shape)
+    {
+        source_ = shape;
+    }
+
+    //! Append a coarser level, the copy must already be triangulated.
+    void addLevel(const TopoDS_Shape &shape, double deflection);
+    void clearLevels(double deflection);
+
+    int nbLevels() const
+    {
+        return static_cast<int>(level_deflections_.size());
+    }
+    double levelDeflection(int level) const
+    {
+        return level_deflections_[level];
+    }
+    const TopoDS_Shape &levelShape(int level) const
+    {
+        return level == 0 ? myshape : level_shapes_[level];
+    }
+
+    int activeLevel() const
+    {
+        return active_level_;
+    }
+    void setActiveLevel(int level)
+    {
+        active_level_ = level;
+    }
+
+    static int displayMode(int level)
+    {
+        return level == 0 ? AIS_Shaded : LOD_MODE_BASE + level;
+    }
+
+    //! Take over a selection built elsewhere, e.g. by the mesh pipeline,
+    //! replacing the one of the same mode. Must be called before the mode is
+    //! activated, activation then skips ComputeSelection().
+    void adoptSelection(const Handle(SelectMgr_Selection) & theSelection);
+
+    Standard_Boolean AcceptDisplayMode(const Standard_Integer theMode) const override;
+
+    //! Add the triangle arrays of the last presentation of a level to
+    //! thePrs with another aspect, the arrays are shared and not copied.
+    void addShadedGroups(const Handle(Prs3d_Presentation) & thePrs,
+                         const Handle(Graphic3d_AspectFillArea3d) & theAspect,
+                         int level = 0) const;
+
+    //! Chunks of the last level 0 presentation taken over from the previous
+    //! one, for statistics
+    int reusedChunks() const
+    {
+        return reused_chunks_;
+    }
+
+protected:
+    void Compute(const Handle(PrsMgr_PresentationManager) & thePrsMgr,
+                 const Handle(Prs3d_Presentation) & thePrs,
+                 const Standard_Integer theMode) override;
+
+private:
+    struct ShadedChunk
+    {
+        // faces of closed solids, drawn in a closed group
+        bool closed = false;
+        std::vector<TopoDS_Face> faces;
+        std::vector<Handle(Poly_Triangulation)> triangulations;
+        Handle(Graphic3d_ArrayOfTriangles) triangles;
+    };
+
+    void computeShaded(const Handle(Prs3d_Presentation) & thePrs, int level);
+    // returns the number of chunks taken over from previous
+    int appendChunks(const std::vector<TopoDS_Face> &faces, bool closed,
+                     const std::vector<ShadedChunk> &previous,
+                     std::vector<ShadedChunk> &chunks);
+
+private:
+
+    TopoDS_Shape source_;
+    // index 0 is unused, level 0 is myshape
+    std::vector<TopoDS_Shape> level_shapes_;
+    std::vector<double> level_deflections_;
+    int active_level_ = 0;
+    // chunks of the last presentation by level, kept across clearLevels()
+    std::vector<std::vector<ShadedChunk>> level_chunks_;
+    int reused_chunks_ = 0;
+};
+
+//! Instance of an OccLodShape part. Without an own color the presentation
+//! is connected to the part's one like any AIS_ConnectedInteractive. With
+//! SetColor() it draws the triangle arrays of the part with its own shading
+//! aspect instead: nothing is meshed or filled again, only the GPU buffers
+//! are the instance's own. Selection is derived from the part in both cases.
+class OccLodInstance : public AIS_ConnectedInteractive
+{
+    DEFINE_STANDARD_RTTIEXT(OccLodInstance, AIS_ConnectedInteractive)
+
+public:
+    OccLodInstance() = default;
+
+protected:
+    void Compute(const Handle(PrsMgr_PresentationManager) & thePrsMgr,
+                 const Handle(Prs3d_Presentation) & thePrs,
+                 const Standard_Integer theMode) override;
+};
+
+} // namespace geotoys
+
+#endif // OCCLODSHAPE_H
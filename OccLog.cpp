@@ -0,0 +1,6 @@
+#include "OccLog.h"
+
+Q_LOGGING_CATEGORY(lcOccRender, "occ.render", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcOccInput, "occ.input", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcOccScene, "occ.scene", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcOccMesh, "occ.mesh", QtInfoMsg)
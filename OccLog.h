@@ -0,0 +1,14 @@
+#ifndef OCCLOG_H
+#define OCCLOG_H
+
+#include <QLoggingCategory>
+
+// Diagnostic logging categories. Debug output is disabled by default and can
+// be enabled at runtime, e.g. QT_LOGGING_RULES="occ.render.debug=true", or
+// compiled out entirely with QT_NO_DEBUG_OUTPUT (set for release builds).
+Q_DECLARE_LOGGING_CATEGORY(lcOccRender)
+Q_DECLARE_LOGGING_CATEGORY(lcOccInput)
+Q_DECLARE_LOGGING_CATEGORY(lcOccScene)
+Q_DECLARE_LOGGING_CATEGORY(lcOccMesh)
+
+#endif // OCCLOG_H
@@ -0,0 +1,454 @@
+#include "OccMeshCache.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <Geom2d_Curve.hxx>
+#include <GeomTools.hxx>
+#include <Geom_Curve.hxx>
+#include <Geom_Surface.hxx>
+#include <NCollection_Array1.hxx>
+#include <Poly_Triangulation.hxx>
+#include <TopExp.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Edge.hxx>
+#include <TopoDS_Face.hxx>
+
+#include "OccLog.h"
+
+namespace geotoys
+{
+
+namespace
+{
+const char MESH_CACHE_MAGIC[4] = {'O', 'Q', 'T', 'C'};
+// 3: key hashes the full face and edge geometry instead of samples
+const uint32_t MESH_CACHE_VERSION = 3;
+const uint32_t FACE_HAS_NORMALS = 0x1;
+
+uint64_t fnv1a(const void *data, size_t size, uint64_t hash)
+{
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template <typename T>
+uint64_t hashValue(const T &value, uint64_t hash)
+{
+    return fnv1a(&value, sizeof(T), hash);
+}
+
+uint64_t hashTrsf(const gp_Trsf &trsf, uint64_t hash)
+{
+    for (int row = 1; row <= 3; ++row)
+    {
+        for (int column = 1; column <= 4; ++column)
+        {
+            hash = hashValue(trsf.Value(row, column), hash);
+        }
+    }
+    return hash;
+}
+
+// Full definition of a curve or surface: GeomTools writes the type and
+// every parameter, poles, weights, knots and multiplicities of splines
+// included, so any edit of the geometry changes the hash
+template <typename Geometry>
+uint64_t hashGeometry(const Handle(Geometry) & geometry, uint64_t hash)
+{
+    if (geometry.IsNull())
+    {
+        return hashValue(-1, hash);
+    }
+    std::ostringstream stream;
+    stream.precision(17);
+    GeomTools::Write(geometry, stream);
+    const std::string text = stream.str();
+    return fnv1a(text.data(), text.size(), hash);
+}
+
+// Geometry of a face as the mesher sees it: surface, edge curves and
+// pcurves with their ranges, locations and tolerances. Moved copies differ.
+uint64_t hashFace(const TopoDS_Face &face, uint64_t hash)
+{
+    hash = hashValue(int(face.Orientation()), hash);
+    TopLoc_Location location;
+    hash = hashGeometry(BRep_Tool::Surface(face, location), hash);
+    hash = hashTrsf(location.Transformation(), hash);
+    hash = hashValue(BRep_Tool::Tolerance(face), hash);
+
+    for (TopExp_Explorer edgeIt(face, TopAbs_EDGE); edgeIt.More(); edgeIt.Next())
+    {
+        const TopoDS_Edge &edge = TopoDS::Edge(edgeIt.Current());
+        hash = hashValue(int(edge.Orientation()), hash);
+        hash = hashValue(BRep_Tool::Degenerated(edge), hash);
+        hash = hashValue(BRep_Tool::Tolerance(edge), hash);
+
+        TopLoc_Location edgeLocation;
+        double first = 0.0;
+        double last = 0.0;
+        hash = hashGeometry(BRep_Tool::Curve(edge, edgeLocation, first, last), hash);
+        hash = hashTrsf(edgeLocation.Transformation(), hash);
+        const double range[2] = {first, last};
+        hash = fnv1a(range, sizeof(range), hash);
+
+        hash = hashGeometry(BRep_Tool::CurveOnSurface(edge, face, first, last), hash);
+        const double pcurveRange[2] = {first, last};
+        hash = fnv1a(pcurveRange, sizeof(pcurveRange), hash);
+    }
+    return hash;
+}
+
+template <typename T>
+void append(QByteArray &buffer, const T &value)
+{
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+// Bounds-checked reader over the file content
+class Reader
+{
+public:
+    explicit Reader(const QByteArray &data)
+        : data_(data)
+    {
+    }
+
+    template <typename T>
+    bool read(T &value)
+    {
+        if (offset_ + sizeof(T) > size_t(data_.size()))
+        {
+            return false;
+        }
+        std::memcpy(&value, data_.constData() + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return true;
+    }
+
+    bool atEnd() const
+    {
+        return offset_ == size_t(data_.size());
+    }
+    size_t remaining() const
+    {
+        return size_t(data_.size()) - offset_;
+    }
+
+private:
+    const QByteArray &data_;
+    size_t offset_ = 0;
+};
+} // namespace
+
+OccMeshCache::OccMeshCache(const std::string &directory, uint64_t max_bytes)
+    : directory_(directory)
+    , max_bytes_(max_bytes)
+{
+    QDir().mkpath(QString::fromStdString(directory_));
+    scanDirectory();
+}
+
+uint64_t OccMeshCache::key(const TopoDS_Shape &shape, double deflection,
+                           double angle) const
+{
+    // geometry only, existing triangulations must not matter. Written per
+    // face instead of BRepTools::Write() of the shape, which would write
+    // the triangulations and the whole topology as well.
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+
+    uint64_t hash = 14695981039346656037ULL;
+    hash = hashValue(faces.Extent(), hash);
+    for (int faceIndex = 1; faceIndex <= faces.Extent(); ++faceIndex)
+    {
+        hash = hashFace(TopoDS::Face(faces.FindKey(faceIndex)), hash);
+    }
+    hash = fnv1a(&deflection, sizeof(deflection), hash);
+    hash = fnv1a(&angle, sizeof(angle), hash);
+    hash = fnv1a(&MESH_CACHE_VERSION, sizeof(MESH_CACHE_VERSION), hash);
+    return hash;
+}
+
+std::string OccMeshCache::entryPath(uint64_t key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.tri", (unsigned long long)key);
+    return directory_ + "/" + name;
+}
+
+bool OccMeshCache::load(uint64_t key, const TopoDS_Shape &shape)
+{
+    QFile file(QString::fromStdString(entryPath(key)));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        ++misses_;
+        return false;
+    }
+    const QByteArray data = file.readAll();
+
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+
+    Reader reader(data);
+    char magic[4] = {};
+    uint32_t version = 0;
+    uint32_t faceCount = 0;
+    if (!reader.read(magic) || std::memcmp(magic, MESH_CACHE_MAGIC, 4) != 0 ||
+        !reader.read(version) || version != MESH_CACHE_VERSION ||
+        !reader.read(faceCount) || int(faceCount) != faces.Extent())
+    {
+        ++misses_;
+        return false;
+    }
+
+    // parse everything first, the shape is modified only for a valid entry
+    NCollection_Array1<Handle(Poly_Triangulation)> triangulations(1, faces.Extent());
+    for (int faceIndex = 1; faceIndex <= faces.Extent(); ++faceIndex)
+    {
+        uint32_t nbNodes = 0;
+        uint32_t nbTriangles = 0;
+        uint32_t flags = 0;
+        double deflection = 0.0;
+        if (!reader.read(nbNodes) || !reader.read(nbTriangles) ||
+            !reader.read(flags) || !reader.read(deflection))
+        {
+            ++misses_;
+            return false;
+        }
+        const bool hasNormals = (flags & FACE_HAS_NORMALS) != 0;
+        if (nbNodes == 0)
+        {
+            if (nbTriangles != 0)
+            {
+                ++misses_;
+                return false;
+            }
+            continue;
+        }
+        // counts must fit the rest of the file before anything is allocated
+        const uint64_t faceBytes = uint64_t(nbNodes) * (3 * sizeof(double)) +
+                                   (hasNormals ? uint64_t(nbNodes) * 3 * sizeof(float) : 0) +
+                                   uint64_t(nbTriangles) * 3 * sizeof(int32_t);
+        if (nbNodes > uint32_t(INT_MAX) || nbTriangles > uint32_t(INT_MAX) ||
+            faceBytes > reader.remaining())
+        {
+            ++misses_;
+            return false;
+        }
+
+        Handle(Poly_Triangulation) triangulation =
+            new Poly_Triangulation(int(nbNodes), int(nbTriangles), false, hasNormals);
+        triangulation->Deflection(deflection);
+        for (int i = 1; i <= int(nbNodes); ++i)
+        {
+            double xyz[3];
+            if (!reader.read(xyz))
+            {
+                ++misses_;
+                return false;
+            }
+            triangulation->SetNode(i, gp_Pnt(xyz[0], xyz[1], xyz[2]));
+        }
+        if (hasNormals)
+        {
+            for (int i = 1; i <= int(nbNodes); ++i)
+            {
+                float normal[3];
+                if (!reader.read(normal))
+                {
+                    ++misses_;
+                    return false;
+                }
+                triangulation->SetNormal(i, gp_Vec3f(normal[0], normal[1], normal[2]));
+            }
+        }
+        for (int i = 1; i <= int(nbTriangles); ++i)
+        {
+            int32_t nodes[3];
+            if (!reader.read(nodes))
+            {
+                ++misses_;
+                return false;
+            }
+            // one based node indices
+            for (int32_t node : nodes)
+            {
+                if (node < 1 || node > int32_t(nbNodes))
+                {
+                    ++misses_;
+                    return false;
+                }
+            }
+            triangulation->SetTriangle(i, Poly_Triangle(nodes[0], nodes[1], nodes[2]));
+        }
+        triangulations.SetValue(faceIndex, triangulation);
+    }
+    if (!reader.atEnd())
+    {
+        ++misses_;
+        return false;
+    }
+
+    BRep_Builder builder;
+    for (int faceIndex = 1; faceIndex <= faces.Extent(); ++faceIndex)
+    {
+        if (!triangulations.Value(faceIndex).IsNull())
+        {
+            builder.UpdateFace(TopoDS::Face(faces.FindKey(faceIndex)),
+                               triangulations.Value(faceIndex));
+        }
+    }
+
+    // recently used entries are evicted last
+    file.setFileTime(QDateTime::currentDateTime(),
+                     QFileDevice::FileModificationTime);
+    ++hits_;
+    return true;
+}
+
+bool OccMeshCache::store(uint64_t key, const TopoDS_Shape &shape)
+{
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+
+    QByteArray buffer;
+    buffer.append(MESH_CACHE_MAGIC, 4);
+    append(buffer, MESH_CACHE_VERSION);
+    append(buffer, uint32_t(faces.Extent()));
+    for (int faceIndex = 1; faceIndex <= faces.Extent(); ++faceIndex)
+    {
+        TopLoc_Location location;
+        const Handle(Poly_Triangulation) &triangulation =
+            BRep_Tool::Triangulation(TopoDS::Face(faces.FindKey(faceIndex)), location);
+        if (triangulation.IsNull())
+        {
+            append(buffer, uint32_t(0));
+            append(buffer, uint32_t(0));
+            append(buffer, uint32_t(0));
+            append(buffer, 0.0);
+            continue;
+        }
+
+        const bool hasNormals = triangulation->HasNormals();
+        append(buffer, uint32_t(triangulation->NbNodes()));
+        append(buffer, uint32_t(triangulation->NbTriangles()));
+        append(buffer, uint32_t(hasNormals ? FACE_HAS_NORMALS : 0));
+        append(buffer, triangulation->Deflection());
+        for (int i = 1; i <= triangulation->NbNodes(); ++i)
+        {
+            const gp_Pnt node = triangulation->Node(i);
+            const double xyz[3] = {node.X(), node.Y(), node.Z()};
+            append(buffer, xyz);
+        }
+        if (hasNormals)
+        {
+            for (int i = 1; i <= triangulation->NbNodes(); ++i)
+            {
+                gp_Vec3f normal;
+                triangulation->Normal(i, normal);
+                const float xyz[3] = {normal.x(), normal.y(), normal.z()};
+                append(buffer, xyz);
+            }
+        }
+        for (int i = 1; i <= triangulation->NbTriangles(); ++i)
+        {
+            int nodes[3];
+            triangulation->Triangle(i).Get(nodes[0], nodes[1], nodes[2]);
+            const int32_t indices[3] = {nodes[0], nodes[1], nodes[2]};
+            append(buffer, indices);
+        }
+    }
+
+    const QString path = QString::fromStdString(entryPath(key));
+    const uint64_t oldSize = uint64_t(QFileInfo(path).size());
+
+    // written to a temporary file and renamed, readers never see partial data
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(buffer) != buffer.size() ||
+        !file.commit())
+    {
+        qCWarning(lcOccMesh) << "Failed to write mesh cache entry:" << path;
+        return false;
+    }
+    ++stores_;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_bytes_ = size_bytes_ - std::min(size_bytes_, oldSize) + uint64_t(buffer.size());
+    if (size_bytes_ > max_bytes_)
+    {
+        evict();
+    }
+    return true;
+}
+
+OccMeshCacheStats OccMeshCache::stats() const
+{
+    OccMeshCacheStats stats;
+    stats.hits = hits_.load();
+    stats.misses = misses_.load();
+    stats.stores = stores_.load();
+    stats.evictions = evictions_.load();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.size_bytes = size_bytes_;
+    }
+    return stats;
+}
+
+void OccMeshCache::scanDirectory()
+{
+    QDir dir(QString::fromStdString(directory_));
+    const QFileInfoList entries = dir.entryInfoList({"*.tri"}, QDir::Files);
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_bytes_ = 0;
+    for (const QFileInfo &entry : entries)
+    {
+        size_bytes_ += uint64_t(entry.size());
+    }
+    if (size_bytes_ > max_bytes_)
+    {
+        evict();
+    }
+}
+
+void OccMeshCache::evict()
+{
+    // mutex_ is held by the caller; oldest modification time first
+    QDir dir(QString::fromStdString(directory_));
+    const QFileInfoList entries =
+        dir.entryInfoList({"*.tri"}, QDir::Files, QDir::Time | QDir::Reversed);
+    for (const QFileInfo &entry : entries)
+    {
+        if (size_bytes_ <= max_bytes_)
+        {
+            break;
+        }
+        const uint64_t size = uint64_t(entry.size());
+        if (QFile::remove(entry.absoluteFilePath()))
+        {
+            size_bytes_ -= std::min(size_bytes_, size);
+            ++evictions_;
+        }
+    }
+}
+
+} // namespace geotoys
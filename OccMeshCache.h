@@ -0,0 +1,70 @@
+#ifndef OCCMESHCACHE_H
+#define OCCMESHCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <TopoDS_Shape.hxx>
+
+namespace geotoys
+{
+
+struct OccMeshCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t stores = 0;
+    uint64_t evictions = 0;
+    uint64_t size_bytes = 0;
+};
+
+// Persistent cache of face triangulations. Entries are keyed by a hash of
+// the face and edge geometry and the meshing parameters, one file per
+// entry. Entries are validated on load, a damaged file counts as a miss.
+// The total size is bounded, least recently used entries are evicted
+// first. All methods are thread-safe.
+class OccMeshCache
+{
+public:
+    OccMeshCache(const std::string &directory, uint64_t max_bytes);
+
+    OccMeshCache(const OccMeshCache &) = delete;
+    OccMeshCache &operator=(const OccMeshCache &) = delete;
+
+    uint64_t key(const TopoDS_Shape &shape, double deflection,
+                 double angle) const;
+
+    // Attach cached triangulations to the faces of shape, false on miss
+    bool load(uint64_t key, const TopoDS_Shape &shape);
+    // Store triangulations of all faces of an already meshed shape
+    bool store(uint64_t key, const TopoDS_Shape &shape);
+
+    OccMeshCacheStats stats() const;
+    const std::string &directory() const
+    {
+        return directory_;
+    }
+
+private:
+    std::string entryPath(uint64_t key) const;
+    void scanDirectory();
+    void evict();
+
+private:
+    std::string directory_;
+    uint64_t max_bytes_ = 0;
+
+    mutable std::mutex mutex_;
+    uint64_t size_bytes_ = 0;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> stores_{0};
+    std::atomic<uint64_t> evictions_{0};
+};
+
+} // namespace geotoys
+
+#endif // OCCMESHCACHE_H
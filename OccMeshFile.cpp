@@ -0,0 +1,431 @@
+#include "OccMeshFile.h"
+
+#include <climits>
+#include <cstring>
+#include <utility>
+
+#include <QSaveFile>
+
+#include <AIS_ConnectedInteractive.hxx>
+#include <AIS_Shape.hxx>
+#include <AIS_Triangulation.hxx>
+#include <BRep_Tool.hxx>
+#include <NCollection_Array1.hxx>
+#include <Poly_ArrayOfNodes.hxx>
+#include <Poly_Triangle.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+#include <gp_Vec3f.hxx>
+
+#include "OccLog.h"
+#include "OccSceneManager.h"
+#include "OccTrace.h"
+
+namespace geotoys
+{
+
+namespace
+{
+const char MESH_FILE_MAGIC[4] = {'O', 'C', 'M', 'F'};
+const uint32_t MESH_FILE_VERSION = 1;
+const uint64_t BLOCK_ALIGNMENT = 16;
+
+struct FileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t object_count;
+    uint32_t reserved;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct ObjectRecord
+{
+    uint32_t id_offset;
+    uint32_t id_size;
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+    float color[3];
+    uint32_t has_normals;
+    uint64_t vertex_offset;
+    uint64_t triangle_offset;
+    uint64_t normal_offset;
+};
+
+static_assert(sizeof(FileHeader) == 32, "unexpected FileHeader padding");
+static_assert(sizeof(ObjectRecord) == 56, "unexpected ObjectRecord padding");
+static_assert(sizeof(Poly_Triangle) == 3 * sizeof(int32_t), "Poly_Triangle layout");
+static_assert(sizeof(gp_Vec3f) == 3 * sizeof(float), "gp_Vec3f layout");
+
+void setError(std::string *error, const std::string &message)
+{
+    if (error)
+    {
+        *error = message;
+    }
+}
+
+uint64_t align(uint64_t offset)
+{
+    return (offset + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+}
+
+bool blockFits(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+    return offset % BLOCK_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+}
+
+// Faces with triangulation of the shape, in the frame of trsf
+void collectFaces(const TopoDS_Shape &shape, const gp_Trsf &trsf,
+                  std::vector<OccMeshFile::SceneFace> &faces)
+{
+    for (TopExp_Explorer exp(shape, TopAbs_FACE); exp.More(); exp.Next())
+    {
+        const TopoDS_Face &face = TopoDS::Face(exp.Current());
+        TopLoc_Location location;
+        const Handle(Poly_Triangulation) &triangulation = BRep_Tool::Triangulation(face, location);
+        if (!triangulation.IsNull() && triangulation->NbTriangles() > 0)
+        {
+            faces.push_back({triangulation, trsf * location.Transformation(),
+                             face.Orientation() == TopAbs_REVERSED});
+        }
+    }
+}
+
+// All faces in one triangulation
+Handle(Poly_Triangulation) mergeFaces(const std::vector<OccMeshFile::SceneFace> &faces)
+{
+    int nbNodes = 0;
+    int nbTriangles = 0;
+    for (const OccMeshFile::SceneFace &face : faces)
+    {
+        nbNodes += face.triangulation->NbNodes();
+        nbTriangles += face.triangulation->NbTriangles();
+    }
+    if (nbTriangles == 0)
+    {
+        return Handle(Poly_Triangulation)();
+    }
+
+    Handle(Poly_Triangulation) merged = new Poly_Triangulation(nbNodes, nbTriangles, false);
+    int nodeOffset = 0;
+    int triangleIndex = 0;
+    for (const OccMeshFile::SceneFace &face : faces)
+    {
+        const Handle(Poly_Triangulation) &faceMesh = face.triangulation;
+        for (int i = 1; i <= faceMesh->NbNodes(); ++i)
+        {
+            merged->SetNode(nodeOffset + i, faceMesh->Node(i).Transformed(face.trsf));
+        }
+        for (int i = 1; i <= faceMesh->NbTriangles(); ++i)
+        {
+            int n1 = 0;
+            int n2 = 0;
+            int n3 = 0;
+            faceMesh->Triangle(i).Get(n1, n2, n3);
+            if (face.reversed)
+            {
+                std::swap(n2, n3);
+            }
+            merged->SetTriangle(++triangleIndex, Poly_Triangle(nodeOffset + n1, nodeOffset + n2,
+                                                               nodeOffset + n3));
+        }
+        nodeOffset += faceMesh->NbNodes();
+    }
+    merged->ComputeNormals();
+    return merged;
+}
+
+template <typename T>
+bool writeBlock(QSaveFile &file, const std::vector<T> &block)
+{
+    const qint64 size = qint64(block.size() * sizeof(T));
+    return file.write(reinterpret_cast<const char *>(block.data()), size) == size;
+}
+
+bool writePadding(QSaveFile &file, uint64_t offset)
+{
+    static const char zeros[BLOCK_ALIGNMENT] = {};
+    const qint64 size = qint64(align(offset) - offset);
+    return size == 0 || file.write(zeros, size) == size;
+}
+} // namespace
+
+OccMeshFile::~OccMeshFile()
+{
+    // the triangulations must not be used past this point
+    objects_.clear();
+    if (data_)
+    {
+        file_.unmap(data_);
+    }
+}
+
+std::shared_ptr<OccMeshFile> OccMeshFile::open(const std::string &path, std::string *error)
+{
+    OCC_TRACE_SCOPE("io", "OccMeshFile::open");
+    std::shared_ptr<OccMeshFile> meshFile(new OccMeshFile());
+    meshFile->file_.setFileName(QString::fromStdString(path));
+    if (!meshFile->file_.open(QIODevice::ReadOnly))
+    {
+        setError(error, "cannot open mesh file " + path);
+        return nullptr;
+    }
+    const uint64_t fileSize = uint64_t(meshFile->file_.size());
+    // private mapping, OCCT gets non-const arrays but never writes them
+    meshFile->data_ = fileSize >= sizeof(FileHeader)
+                          ? meshFile->file_.map(0, qint64(fileSize), QFileDevice::MapPrivateOption)
+                          : nullptr;
+    const uchar *data = meshFile->data_;
+    if (!data)
+    {
+        setError(error, "cannot map mesh file " + path);
+        return nullptr;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    const uint64_t recordsSize = uint64_t(header.object_count) * sizeof(ObjectRecord);
+    if (std::memcmp(header.magic, MESH_FILE_MAGIC, 4) != 0 ||
+        header.version != MESH_FILE_VERSION ||
+        recordsSize > fileSize - sizeof(FileHeader) ||
+        header.strings_offset > fileSize ||
+        header.strings_size > fileSize - header.strings_offset)
+    {
+        setError(error, "invalid mesh file header " + path);
+        return nullptr;
+    }
+
+    const char *strings = reinterpret_cast<const char *>(data + header.strings_offset);
+    meshFile->objects_.reserve(header.object_count);
+    for (uint32_t index = 0; index < header.object_count; ++index)
+    {
+        ObjectRecord record;
+        std::memcpy(&record, data + sizeof(FileHeader) + index * sizeof(ObjectRecord),
+                    sizeof(record));
+        const uint64_t vertexBytes = uint64_t(record.vertex_count) * sizeof(gp_Vec3f);
+        if (uint64_t(record.id_offset) + record.id_size > header.strings_size ||
+            record.vertex_count == 0 || record.triangle_count == 0 ||
+            record.vertex_count > uint32_t(INT_MAX) || record.triangle_count > uint32_t(INT_MAX) ||
+            !blockFits(record.vertex_offset, vertexBytes, fileSize) ||
+            !blockFits(record.triangle_offset,
+                       uint64_t(record.triangle_count) * sizeof(Poly_Triangle), fileSize) ||
+            record.has_normals > 1 ||
+            (record.has_normals && !blockFits(record.normal_offset, vertexBytes, fileSize)))
+        {
+            setError(error, "invalid mesh file object record " + path);
+            return nullptr;
+        }
+        // the triangles are aliased as they are, one bad index would make
+        // OCCT read outside the vertex block
+        const auto *indices = reinterpret_cast<const int32_t *>(data + record.triangle_offset);
+        const uint64_t indexCount = uint64_t(record.triangle_count) * 3;
+        for (uint64_t i = 0; i < indexCount; ++i)
+        {
+            if (indices[i] < 1 || indices[i] > int32_t(record.vertex_count))
+            {
+                setError(error, "invalid mesh file triangle index " + path);
+                return nullptr;
+            }
+        }
+
+        // alias the mapping, nothing is copied
+        Object object;
+        object.id.assign(strings + record.id_offset, record.id_size);
+        object.color = Quantity_Color(record.color[0], record.color[1], record.color[2],
+                                      Quantity_TOC_RGB);
+        object.triangulation = new Poly_Triangulation();
+        Poly_ArrayOfNodes nodes(
+            *reinterpret_cast<const gp_Vec3f *>(data + record.vertex_offset),
+            int(record.vertex_count));
+        object.triangulation->InternalNodes().Move(nodes);
+        Poly_Array1OfTriangle triangles(
+            *reinterpret_cast<const Poly_Triangle *>(data + record.triangle_offset), 1,
+            int(record.triangle_count));
+        object.triangulation->InternalTriangles().Move(triangles);
+        if (record.has_normals)
+        {
+            NCollection_Array1<gp_Vec3f> normals(
+                *reinterpret_cast<const gp_Vec3f *>(data + record.normal_offset), 1,
+                int(record.vertex_count));
+            object.triangulation->InternalNormals().Move(normals);
+        }
+        else
+        {
+            object.triangulation->ComputeNormals();
+        }
+        meshFile->objects_.push_back(std::move(object));
+    }
+    return meshFile;
+}
+
+std::vector<OccMeshFile::SceneObject> OccMeshFile::collectScene(const OccSceneManager &scene)
+{
+    OCC_TRACE_SCOPE("io", "OccMeshFile::collectScene");
+    std::vector<SceneObject> objects;
+    for (const std::string &id : scene.getAllShapeIds())
+    {
+        const Handle(AIS_InteractiveObject) object = scene.getObject(id);
+        if (object.IsNull())
+        {
+            continue;
+        }
+
+        SceneObject entry;
+        entry.id = id;
+        if (object->HasColor())
+        {
+            object->Color(entry.color);
+        }
+        Handle(AIS_Triangulation) mesh = Handle(AIS_Triangulation)::DownCast(object);
+        Handle(AIS_ConnectedInteractive) instance =
+            Handle(AIS_ConnectedInteractive)::DownCast(object);
+        Handle(AIS_Shape) shape = Handle(AIS_Shape)::DownCast(object);
+        if (!mesh.IsNull() && !mesh->GetTriangulation().IsNull())
+        {
+            entry.mesh = new Poly_Triangulation(mesh->GetTriangulation());
+        }
+        else if (!instance.IsNull())
+        {
+            Handle(AIS_Shape) part = Handle(AIS_Shape)::DownCast(instance->ConnectedTo());
+            if (!part.IsNull())
+            {
+                if (!object->HasColor())
+                {
+                    part->Color(entry.color);
+                }
+                collectFaces(part->Shape(), instance->LocalTransformation(), entry.faces);
+            }
+        }
+        else if (!shape.IsNull())
+        {
+            collectFaces(shape->Shape(), gp_Trsf(), entry.faces);
+        }
+
+        // shapes still meshing in background are skipped
+        if ((!entry.mesh.IsNull() && entry.mesh->NbTriangles() > 0) || !entry.faces.empty())
+        {
+            objects.push_back(std::move(entry));
+        }
+    }
+    return objects;
+}
+
+bool OccMeshFile::writeScene(const std::vector<SceneObject> &scene, const std::string &path,
+                             std::string *error)
+{
+    OCC_TRACE_SCOPE("io", "OccMeshFile::writeScene");
+    std::vector<Object> objects;
+    objects.reserve(scene.size());
+    for (const SceneObject &source : scene)
+    {
+        Object object;
+        object.id = source.id;
+        object.color = source.color;
+        object.triangulation = source.mesh.IsNull() ? mergeFaces(source.faces) : source.mesh;
+        if (!object.triangulation.IsNull())
+        {
+            objects.push_back(std::move(object));
+        }
+    }
+    return write(objects, path, error);
+}
+
+bool OccMeshFile::write(const std::vector<Object> &objects, const std::string &path,
+                        std::string *error)
+{
+    OCC_TRACE_SCOPE("io", "OccMeshFile::write");
+    FileHeader header = {};
+    std::memcpy(header.magic, MESH_FILE_MAGIC, 4);
+    header.version = MESH_FILE_VERSION;
+    header.object_count = uint32_t(objects.size());
+    header.strings_offset = sizeof(FileHeader) + objects.size() * sizeof(ObjectRecord);
+
+    // layout first, then one sequential pass over the objects
+    std::vector<ObjectRecord> records(objects.size());
+    std::string strings;
+    for (size_t index = 0; index < objects.size(); ++index)
+    {
+        ObjectRecord &record = records[index];
+        record.id_offset = uint32_t(strings.size());
+        record.id_size = uint32_t(objects[index].id.size());
+        strings += objects[index].id;
+    }
+    header.strings_size = strings.size();
+
+    uint64_t offset = header.strings_offset + header.strings_size;
+    for (size_t index = 0; index < objects.size(); ++index)
+    {
+        const Object &object = objects[index];
+        ObjectRecord &record = records[index];
+        const Handle(Poly_Triangulation) &triangulation = object.triangulation;
+        record.vertex_count = uint32_t(triangulation->NbNodes());
+        record.triangle_count = uint32_t(triangulation->NbTriangles());
+        record.color[0] = float(object.color.Red());
+        record.color[1] = float(object.color.Green());
+        record.color[2] = float(object.color.Blue());
+        record.has_normals = triangulation->HasNormals() ? 1 : 0;
+
+        const uint64_t vertexBytes = uint64_t(record.vertex_count) * sizeof(gp_Vec3f);
+        record.vertex_offset = align(offset);
+        record.triangle_offset = align(record.vertex_offset + vertexBytes);
+        offset = record.triangle_offset + uint64_t(record.triangle_count) * sizeof(Poly_Triangle);
+        if (record.has_normals)
+        {
+            record.normal_offset = align(offset);
+            offset = record.normal_offset + vertexBytes;
+        }
+    }
+
+    QSaveFile file(QString::fromStdString(path));
+    bool ok = file.open(QIODevice::WriteOnly) &&
+              file.write(reinterpret_cast<const char *>(&header), sizeof(header)) ==
+                  qint64(sizeof(header)) &&
+              writeBlock(file, records) &&
+              file.write(strings.data(), qint64(strings.size())) == qint64(strings.size());
+
+    offset = header.strings_offset + header.strings_size;
+    for (size_t index = 0; ok && index < objects.size(); ++index)
+    {
+        const Handle(Poly_Triangulation) &triangulation = objects[index].triangulation;
+        const ObjectRecord &record = records[index];
+
+        std::vector<gp_Vec3f> vertices(record.vertex_count);
+        for (int i = 1; i <= int(record.vertex_count); ++i)
+        {
+            const gp_Pnt node = triangulation->Node(i);
+            vertices[i - 1] = gp_Vec3f(float(node.X()), float(node.Y()), float(node.Z()));
+        }
+        std::vector<Poly_Triangle> triangles(record.triangle_count);
+        for (int i = 1; i <= int(record.triangle_count); ++i)
+        {
+            triangles[i - 1] = triangulation->Triangle(i);
+        }
+
+        ok = writePadding(file, offset) && writeBlock(file, vertices);
+        offset = record.vertex_offset + vertices.size() * sizeof(gp_Vec3f);
+        ok = ok && writePadding(file, offset) && writeBlock(file, triangles);
+        offset = record.triangle_offset + triangles.size() * sizeof(Poly_Triangle);
+        if (ok && record.has_normals)
+        {
+            std::vector<gp_Vec3f> normals(record.vertex_count);
+            for (int i = 1; i <= int(record.vertex_count); ++i)
+            {
+                triangulation->Normal(i, normals[i - 1]);
+            }
+            ok = writePadding(file, offset) && writeBlock(file, normals);
+            offset = record.normal_offset + normals.size() * sizeof(gp_Vec3f);
+        }
+    }
+
+    if (!ok || !file.commit())
+    {
+        setError(error, "cannot write mesh file " + path);
+        return false;
+    }
+    qCDebug(lcOccScene) << "Wrote" << objects.size() << "meshes to" << path.c_str();
+    return true;
+}
+
+} // namespace geotoys
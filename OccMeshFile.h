@@ -0,0 +1,88 @@
+#ifndef OCCMESHFILE_H
+#define OCCMESHFILE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QFile>
+
+#include <Poly_Triangulation.hxx>
+#include <Quantity_Color.hxx>
+#include <gp_Trsf.hxx>
+
+namespace geotoys
+{
+class OccSceneManager;
+
+// Pre-tessellated scene file, little endian:
+//   FileHeader                      magic "OCMF", version, object count,
+//                                   string block offset and size
+//   ObjectRecord[object_count]      id in the string block, color, counts
+//                                   and offsets of the data blocks
+//   char strings[]                  ids, UTF-8, not terminated
+//   data blocks, 16 byte aligned:   float positions[3 * vertex_count]
+//                                   int32 triangles[3 * triangle_count]
+//                                   float normals[3 * vertex_count]
+// Triangles are one based so that the block has the Poly_Triangle layout.
+//
+// The file is memory mapped and the triangulations alias the mapping, so
+// loading costs page-ins instead of parsing. The OccMeshFile must outlive
+// every triangulation taken from it.
+class OccMeshFile
+{
+public:
+    struct Object
+    {
+        std::string id;
+        Quantity_Color color = Quantity_NOC_YELLOW;
+        Handle(Poly_Triangulation) triangulation;
+    };
+
+    ~OccMeshFile();
+
+    static std::shared_ptr<OccMeshFile> open(const std::string &path,
+                                             std::string *error = nullptr);
+    const std::vector<Object> &objects() const
+    {
+        return objects_;
+    }
+
+    // Triangulations of a displayed object, see collectScene()
+    struct SceneFace
+    {
+        Handle(Poly_Triangulation) triangulation;
+        gp_Trsf trsf;
+        bool reversed = false;
+    };
+    struct SceneObject
+    {
+        std::string id;
+        Quantity_Color color = Quantity_NOC_YELLOW;
+        // triangle meshes, copied since their vertices can be rewritten
+        Handle(Poly_Triangulation) mesh;
+        // faces of shapes and instances, taken by handle
+        std::vector<SceneFace> faces;
+    };
+
+    // Takes the triangulations of every displayed object, instances with
+    // their location. Render thread only, no merging is done here.
+    static std::vector<SceneObject> collectScene(const OccSceneManager &scene);
+    // Merges the faces of each object into one mesh per id, any thread
+    static bool writeScene(const std::vector<SceneObject> &scene, const std::string &path,
+                           std::string *error = nullptr);
+    static bool write(const std::vector<Object> &objects, const std::string &path,
+                      std::string *error = nullptr);
+
+private:
+    OccMeshFile() = default;
+
+private:
+    QFile file_;
+    uchar *data_ = nullptr;
+    std::vector<Object> objects_;
+};
+
+} // namespace geotoys
+
+#endif // OCCMESHFILE_H
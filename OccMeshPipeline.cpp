@@ -0,0 +1,690 @@
+#include "OccMeshPipeline.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+
+#include <QElapsedTimer>
+
+#include <Bnd_Box.hxx>
+#include <BRepAdaptor_Curve.hxx>
+#include <BRepAdaptor_Surface.hxx>
+#include <BRepBuilderAPI_Copy.hxx>
+#include <BRepBndLib.hxx>
+#include <BRepLib_ToolTriangulatedShape.hxx>
+#include <BRepMesh_IncrementalMesh.hxx>
+#include <BRepTools.hxx>
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <Precision.hxx>
+#include <Prs3d_Drawer.hxx>
+#include <Standard_Failure.hxx>
+#include <Select3D_SensitiveTriangulation.hxx>
+#include <StdSelect_BRepOwner.hxx>
+#include <StdSelect_BRepSelectionTool.hxx>
+#include <TopExp.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
+
+#include "OccLodShape.h"
+#include "OccLog.h"
+#include "OccTrace.h"
+
+namespace geotoys
+{
+
+namespace
+{
+// Same formula as Prs3d::GetDeflection() for relative deflection
+double absoluteDeflection(const TopoDS_Shape &shape, double coefficient)
+{
+    Bnd_Box box;
+    BRepBndLib::Add(shape, box, false);
+    if (box.IsVoid())
+    {
+        return coefficient;
+    }
+
+    double xmin, ymin, zmin, xmax, ymax, zmax;
+    box.Get(xmin, ymin, zmin, xmax, ymax, zmax);
+    const double extent =
+        std::max({xmax - xmin, ymax - ymin, zmax - zmin, Precision::Confusion()});
+    return extent * coefficient * 4.0;
+}
+
+// Geometric identity of a face, equal for an unchanged face regenerated by
+// a parametric edit: surface type, orientation, surface points over the
+// parameter range, the sorted vertex positions and, for the trims, points
+// along each edge curve, quantized
+std::vector<int64_t> faceKey(const TopoDS_Face &face)
+{
+    const double quantum = Precision::Confusion();
+    auto quantize = [quantum](double value) { return int64_t(std::llround(value / quantum)); };
+
+    BRepAdaptor_Surface surface(face);
+    std::vector<int64_t> key;
+    key.push_back(int64_t(surface.GetType()));
+    key.push_back(int64_t(face.Orientation()));
+
+    double u1, u2, v1, v2;
+    BRepTools::UVBounds(face, u1, u2, v1, v2);
+    for (int i = 0; i <= 2; ++i)
+    {
+        for (int j = 0; j <= 2; ++j)
+        {
+            const gp_Pnt point =
+                surface.Value(u1 + (u2 - u1) * i * 0.5, v1 + (v2 - v1) * j * 0.5);
+            key.push_back(quantize(point.X()));
+            key.push_back(quantize(point.Y()));
+            key.push_back(quantize(point.Z()));
+        }
+    }
+
+    TopTools_IndexedMapOfShape vertices;
+    TopExp::MapShapes(face, TopAbs_VERTEX, vertices);
+    std::vector<std::array<int64_t, 3>> points;
+    points.reserve(size_t(vertices.Extent()));
+    for (int i = 1; i <= vertices.Extent(); ++i)
+    {
+        const gp_Pnt point = BRep_Tool::Pnt(TopoDS::Vertex(vertices(i)));
+        points.push_back({quantize(point.X()), quantize(point.Y()), quantize(point.Z())});
+    }
+    std::sort(points.begin(), points.end());
+    for (const std::array<int64_t, 3> &point : points)
+    {
+        key.insert(key.end(), point.begin(), point.end());
+    }
+
+    // a moved hole or a bent edge keeps the surface and the vertices,
+    // sorted so that the key does not depend on the wire order
+    TopTools_IndexedMapOfShape edges;
+    TopExp::MapShapes(face, TopAbs_EDGE, edges);
+    std::vector<std::vector<int64_t>> edgeKeys;
+    edgeKeys.reserve(size_t(edges.Extent()));
+    for (int i = 1; i <= edges.Extent(); ++i)
+    {
+        const TopoDS_Edge &edge = TopoDS::Edge(edges(i));
+        std::vector<int64_t> &edgeKey = edgeKeys.emplace_back();
+        if (BRep_Tool::Degenerated(edge))
+        {
+            continue;
+        }
+        BRepAdaptor_Curve curve(edge);
+        edgeKey.push_back(int64_t(curve.GetType()));
+        const double first = curve.FirstParameter();
+        const double last = curve.LastParameter();
+        for (int j = 1; j <= 3; ++j)
+        {
+            const gp_Pnt point = curve.Value(first + (last - first) * j * 0.25);
+            edgeKey.push_back(quantize(point.X()));
+            edgeKey.push_back(quantize(point.Y()));
+            edgeKey.push_back(quantize(point.Z()));
+        }
+    }
+    std::sort(edgeKeys.begin(), edgeKeys.end());
+    for (const std::vector<int64_t> &edgeKey : edgeKeys)
+    {
+        key.push_back(int64_t(edgeKey.size()));
+        key.insert(key.end(), edgeKey.begin(), edgeKey.end());
+    }
+    return key;
+}
+
+bool hasTriangulation(const TopoDS_Face &face, double deflection)
+{
+    TopLoc_Location location;
+    const Handle(Poly_Triangulation) &triangulation = BRep_Tool::Triangulation(face, location);
+    return !triangulation.IsNull() &&
+           triangulation->Deflection() <= deflection + Precision::Confusion();
+}
+
+// StdSelect_BRepSelectionTool::Load() of the whole shape for an update:
+// the entities of faces whose triangulation is unchanged are taken over
+// from the previous selection, only the other faces are computed again
+void loadSelection(const Handle(SelectMgr_Selection) & selection, const OccSelectionJob &job)
+{
+    std::unordered_map<const Poly_Triangulation *, Handle(Select3D_SensitiveTriangulation)>
+        previous;
+    for (const Handle(Select3D_SensitiveEntity) &entity : job.reuse)
+    {
+        Handle(Select3D_SensitiveTriangulation) triangulation =
+            Handle(Select3D_SensitiveTriangulation)::DownCast(entity);
+        if (!triangulation.IsNull() && !triangulation->Triangulation().IsNull())
+        {
+            previous.emplace(triangulation->Triangulation().get(), triangulation);
+        }
+    }
+
+    const int priority =
+        StdSelect_BRepSelectionTool::GetStandardPriority(job.shape, TopAbs_SHAPE);
+    Handle(StdSelect_BRepOwner) owner = new StdSelect_BRepOwner(job.shape, priority);
+    owner->SetSelectable(job.ais_shape);
+    // same parameters and sub-shapes as Load(): free vertices, free edges
+    // and faces
+    const int pointsOnEdge = 9;
+    const double maxParameter = 500.0;
+    auto compute = [&](const TopoDS_Shape &shape) {
+        StdSelect_BRepSelectionTool::ComputeSensitive(shape, owner, selection, job.deflection,
+                                                      job.angle, pointsOnEdge, maxParameter,
+                                                      false);
+    };
+    for (TopExp_Explorer exp(job.shape, TopAbs_VERTEX, TopAbs_EDGE); exp.More(); exp.Next())
+    {
+        compute(exp.Current());
+    }
+    for (TopExp_Explorer exp(job.shape, TopAbs_EDGE, TopAbs_FACE); exp.More(); exp.Next())
+    {
+        compute(exp.Current());
+    }
+    for (TopExp_Explorer exp(job.shape, TopAbs_FACE); exp.More(); exp.Next())
+    {
+        TopLoc_Location location;
+        const Handle(Poly_Triangulation) &triangulation =
+            BRep_Tool::Triangulation(TopoDS::Face(exp.Current()), location);
+        auto it = triangulation.IsNull() ? previous.end() : previous.find(triangulation.get());
+        if (it != previous.end() && it->second->GetInitLocation().IsEqual(location))
+        {
+            // the entity keeps its BVH, only the owner is the new one
+            it->second->Set(owner);
+            selection->Add(it->second);
+            previous.erase(it);
+            continue;
+        }
+        compute(exp.Current());
+    }
+}
+} // namespace
+
+OccMeshPipeline::OccMeshPipeline(int max_threads)
+{
+    if (max_threads > 0)
+    {
+        pool_.setMaxThreadCount(max_threads);
+    }
+}
+
+OccMeshPipeline::~OccMeshPipeline()
+{
+    pool_.clear();
+    pool_.waitForDone();
+}
+
+void OccMeshPipeline::setMeshParameters(const OccMeshParameters &params)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    params_ = params;
+}
+
+OccMeshParameters OccMeshPipeline::meshParameters() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return params_;
+}
+
+void OccMeshPipeline::setCache(std::shared_ptr<OccMeshCache> cache)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_ = std::move(cache);
+}
+
+std::shared_ptr<OccMeshCache> OccMeshPipeline::cache() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cache_;
+}
+
+void OccMeshPipeline::setFinishedCallback(std::function<void()> callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_callback_ = std::move(callback);
+}
+
+void OccMeshPipeline::submit(OccMeshJob job)
+{
+    const OccMeshParameters params = meshParameters();
+    std::shared_ptr<OccMeshCache> meshCache = cache();
+    ++in_flight_;
+    pool_.start([this, job = std::move(job), params, meshCache]() {
+        OccMeshResult result = runGuarded(job, params, meshCache);
+
+        std::function<void()> callback;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_.push_back(std::move(result));
+            callback = finished_callback_;
+        }
+        --in_flight_;
+
+        if (callback)
+        {
+            callback();
+        }
+    });
+}
+
+void OccMeshPipeline::start(std::function<void()> task)
+{
+    pool_.start(std::move(task));
+}
+
+std::vector<OccMeshResult> OccMeshPipeline::takeFinished(size_t max_count)
+{
+    std::vector<OccMeshResult> results;
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t count = std::min(max_count, finished_.size());
+    results.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        results.push_back(std::move(finished_.front()));
+        finished_.pop_front();
+    }
+    return results;
+}
+
+bool OccMeshPipeline::hasFinished() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !finished_.empty();
+}
+
+void OccMeshPipeline::submitSelection(OccSelectionJob job)
+{
+    pool_.start([this, job = std::move(job)]() {
+        OCC_TRACE_SCOPE("selection", "OccMeshPipeline::buildSelection");
+        QElapsedTimer timer;
+        timer.start();
+
+        // same entities as AIS_Shape::ComputeSelection() for mode 0, but
+        // built into a detached selection so the object is not touched
+        OccSelectionResult result;
+        result.id = job.id;
+        result.generation = job.generation;
+        result.ais_shape = job.ais_shape;
+        result.prototype = job.prototype;
+        result.selection = new SelectMgr_Selection(0);
+        try
+        {
+            if (job.reuse.empty())
+            {
+                StdSelect_BRepSelectionTool::Load(result.selection, job.ais_shape, job.shape,
+                                                  TopAbs_SHAPE, job.deflection, job.angle,
+                                                  false);
+            }
+            else
+            {
+                loadSelection(result.selection, job);
+            }
+            StdSelect_BRepSelectionTool::PreBuildBVH(result.selection);
+        }
+        catch (const Standard_Failure &failure)
+        {
+            qCWarning(lcOccMesh) << "Selection failed for" << job.id.c_str() << ":"
+                                 << failure.GetMessageString();
+            result.selection = new SelectMgr_Selection(0);
+        }
+        result.build_ms = double(timer.nsecsElapsed()) / 1.0e6;
+
+        std::function<void()> callback;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            selections_.push_back(std::move(result));
+            callback = finished_callback_;
+        }
+        if (callback)
+        {
+            callback();
+        }
+    });
+}
+
+std::vector<OccSelectionResult> OccMeshPipeline::takeSelections(size_t max_count)
+{
+    std::vector<OccSelectionResult> results;
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t count = std::min(max_count, selections_.size());
+    results.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        results.push_back(std::move(selections_.front()));
+        selections_.pop_front();
+    }
+    return results;
+}
+
+bool OccMeshPipeline::hasSelections() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !selections_.empty();
+}
+
+void OccMeshPipeline::waitForDone()
+{
+    pool_.waitForDone();
+}
+
+OccMeshResult OccMeshPipeline::prepare(const OccMeshJob &job)
+{
+    return runGuarded(job, meshParameters(), cache());
+}
+
+OccMeshResult OccMeshPipeline::runGuarded(const OccMeshJob &job, const OccMeshParameters &params,
+                                          const std::shared_ptr<OccMeshCache> &cache)
+{
+    // BRepMesh throws on bad geometry, which must not leave a pool thread
+    try
+    {
+        return run(job, params, cache);
+    }
+    catch (const Standard_Failure &failure)
+    {
+        qCWarning(lcOccMesh) << "Meshing failed for" << job.id.c_str() << ":"
+                             << failure.GetMessageString();
+        return failedResult(job, failure.GetMessageString());
+    }
+    catch (const std::exception &error)
+    {
+        qCWarning(lcOccMesh) << "Meshing failed for" << job.id.c_str() << ":" << error.what();
+        return failedResult(job, error.what());
+    }
+    catch (...)
+    {
+        qCWarning(lcOccMesh) << "Meshing failed for" << job.id.c_str();
+        return failedResult(job, "unknown error");
+    }
+}
+
+OccMeshResult OccMeshPipeline::failedResult(const OccMeshJob &job, const char *error)
+{
+    OccMeshResult result;
+    result.id = job.id;
+    result.generation = job.generation;
+    result.display = job.display;
+    result.prototype = job.prototype;
+    result.failed = true;
+    result.error = error != nullptr ? error : "";
+    return result;
+}
+
+OccMeshResult OccMeshPipeline::run(const OccMeshJob &job,
+                                   const OccMeshParameters &params,
+                                   const std::shared_ptr<OccMeshCache> &cache)
+{
+    OCC_TRACE_SCOPE("mesh", "OccMeshPipeline::run");
+    QElapsedTimer timer;
+    timer.start();
+
+    const bool update = !job.previous.IsNull() && job.deflection > 0.0;
+    const double deflection =
+        update ? job.deflection : absoluteDeflection(job.shape, params.deviation_coefficient);
+    // other jobs may mesh shapes sharing faces with job.shape, the copy is
+    // written by this job only
+    const TopoDS_Shape meshed = BRepBuilderAPI_Copy(job.shape, false, false).Shape();
+    bool cacheHit = false;
+    std::vector<int> twins;
+    if (update)
+    {
+        twins = matchFaces(job.previous_source, job.previous, job.shape);
+        const OccRemeshStats stats =
+            remeshShape(job.previous, twins, meshed, deflection, params.deviation_angle);
+        qCDebug(lcOccMesh) << "Update of" << job.id.c_str() << "remeshed" << stats.remeshed
+                           << "of" << stats.faces << "faces";
+    }
+    else
+    {
+        cacheHit = meshShape(meshed, deflection, params.deviation_angle, cache);
+    }
+
+    // The presentation must reuse this triangulation instead of meshing
+    // again on the render thread
+    // always an OccLodShape, with a single level when LOD is off, so that
+    // selection built in background can be adopted
+    Handle(OccLodShape) aisShape = new OccLodShape(meshed, deflection);
+    aisShape->setSource(job.shape);
+    double levelDeflection = deflection;
+    for (int level = 1; level < params.lod_levels; ++level)
+    {
+        // coarser levels are meshed on topology copies sharing the geometry
+        levelDeflection *= params.lod_factor;
+        TopoDS_Shape copy = BRepBuilderAPI_Copy(job.shape, false, false).Shape();
+        if (update && level < int(job.previous_levels.size()) &&
+            !job.previous_levels[level].IsNull())
+        {
+            // the previous level copies have the face order of previous
+            remeshShape(job.previous_levels[level], twins, copy, levelDeflection,
+                        params.deviation_angle);
+        }
+        else
+        {
+            meshShape(copy, levelDeflection, params.deviation_angle, cache);
+        }
+        aisShape->addLevel(copy, levelDeflection);
+    }
+    aisShape->SetColor(job.color);
+    aisShape->Attributes()->SetTypeOfDeflection(Aspect_TOD_ABSOLUTE);
+    aisShape->Attributes()->SetMaximalChordialDeviation(deflection);
+    aisShape->Attributes()->SetDeviationAngle(params.deviation_angle);
+    aisShape->Attributes()->SetAutoTriangulation(false);
+
+    OccMeshResult result;
+    result.id = job.id;
+    result.generation = job.generation;
+    result.ais_shape = aisShape;
+    result.display = job.display;
+    result.mesh_ms = double(timer.nsecsElapsed()) / 1.0e6;
+    result.cache_hit = cacheHit;
+    result.prototype = job.prototype;
+    result.update = update;
+    for (int level = 0; level < aisShape->nbLevels(); ++level)
+    {
+        addMeshBytes(aisShape->levelShape(level), result.triangulation_bytes,
+                     result.presentation_bytes);
+    }
+    return result;
+}
+
+bool OccMeshPipeline::meshShape(const TopoDS_Shape &shape, double deflection,
+                                double angle,
+                                const std::shared_ptr<OccMeshCache> &cache)
+{
+    OCC_TRACE_SCOPE("mesh", "OccMeshPipeline::meshShape");
+    uint64_t cacheKey = 0;
+    if (cache)
+    {
+        cacheKey = cache->key(shape, deflection, angle);
+        if (cache->load(cacheKey, shape))
+        {
+            return true;
+        }
+    }
+
+    // Shapes are independent of each other, the pool provides the parallelism
+    IMeshTools_Parameters meshParams;
+    meshParams.Deflection = deflection;
+    meshParams.Angle = angle;
+    meshParams.InParallel = false;
+    BRepMesh_IncrementalMesh mesher(shape, meshParams);
+
+    // Normals are otherwise computed lazily by StdPrs_ShadedShape on display
+    for (TopExp_Explorer exp(shape, TopAbs_FACE); exp.More(); exp.Next())
+    {
+        const TopoDS_Face &face = TopoDS::Face(exp.Current());
+        TopLoc_Location location;
+        const Handle(Poly_Triangulation) &triangulation =
+            BRep_Tool::Triangulation(face, location);
+        if (!triangulation.IsNull() && !triangulation->HasNormals())
+        {
+            BRepLib_ToolTriangulatedShape::ComputeNormals(face, triangulation);
+        }
+    }
+
+    if (cache)
+    {
+        cache->store(cacheKey, shape);
+    }
+    return false;
+}
+
+std::vector<int> OccMeshPipeline::matchFaces(const TopoDS_Shape &previousSource,
+                                             const TopoDS_Shape &previous,
+                                             const TopoDS_Shape &shape)
+{
+    OCC_TRACE_SCOPE("mesh", "OccMeshPipeline::matchFaces");
+    TopTools_IndexedMapOfShape faces;
+    TopTools_IndexedMapOfShape sourceFaces;
+    TopTools_IndexedMapOfShape previousFaces;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+    TopExp::MapShapes(previousSource, TopAbs_FACE, sourceFaces);
+    TopExp::MapShapes(previous, TopAbs_FACE, previousFaces);
+    std::vector<int> twins(size_t(faces.Extent()) + 1, 0);
+
+    // faces shared with the previous source, the copy maps them in the
+    // same order
+    std::vector<bool> matched(size_t(previousFaces.Extent()) + 1, false);
+    std::vector<int> unmatched;
+    const bool sameOrder = sourceFaces.Extent() == previousFaces.Extent();
+    for (int i = 1; i <= faces.Extent(); ++i)
+    {
+        const int index = sameOrder ? sourceFaces.FindIndex(faces(i)) : 0;
+        if (index > 0)
+        {
+            twins[i] = index;
+            matched[index] = true;
+        }
+        else
+        {
+            unmatched.push_back(i);
+        }
+    }
+    if (unmatched.empty())
+    {
+        return twins;
+    }
+
+    // rebuilt but unchanged faces match by geometry, the triangulation is
+    // in the local frame of the face so the locations must match
+    std::map<std::vector<int64_t>, int> previousKeys;
+    for (int j = 1; j <= previousFaces.Extent(); ++j)
+    {
+        if (!matched[j])
+        {
+            previousKeys.emplace(faceKey(TopoDS::Face(previousFaces(j))), j);
+        }
+    }
+    for (int i : unmatched)
+    {
+        const TopoDS_Face &face = TopoDS::Face(faces(i));
+        auto it = previousKeys.find(faceKey(face));
+        if (it != previousKeys.end() &&
+            previousFaces(it->second).Location().IsEqual(face.Location()))
+        {
+            twins[i] = it->second;
+        }
+    }
+    return twins;
+}
+
+OccRemeshStats OccMeshPipeline::remeshShape(const TopoDS_Shape &previous,
+                                            const std::vector<int> &twins,
+                                            const TopoDS_Shape &shape, double deflection,
+                                            double angle)
+{
+    OCC_TRACE_SCOPE("mesh", "OccMeshPipeline::remeshShape");
+    OccRemeshStats stats;
+    TopTools_IndexedMapOfShape faces;
+    TopTools_IndexedMapOfShape previousFaces;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+    TopExp::MapShapes(previous, TopAbs_FACE, previousFaces);
+    stats.faces = faces.Extent();
+
+    std::vector<TopoDS_Face> missing;
+    BRep_Builder builder;
+    for (int i = 1; i <= faces.Extent(); ++i)
+    {
+        const TopoDS_Face &face = TopoDS::Face(faces(i));
+        const int twin = i < int(twins.size()) ? twins[i] : 0;
+        if (twin > 0 && twin <= previousFaces.Extent())
+        {
+            const TopoDS_Face &previousFace = TopoDS::Face(previousFaces(twin));
+            if (hasTriangulation(previousFace, deflection))
+            {
+                TopLoc_Location location;
+                builder.UpdateFace(face, BRep_Tool::Triangulation(previousFace, location));
+                ++stats.reused;
+                continue;
+            }
+        }
+        missing.push_back(face);
+    }
+    if (missing.empty())
+    {
+        return stats;
+    }
+
+    TopoDS_Compound changed;
+    builder.MakeCompound(changed);
+    for (const TopoDS_Face &face : missing)
+    {
+        builder.Add(changed, face);
+    }
+    IMeshTools_Parameters meshParams;
+    meshParams.Deflection = deflection;
+    meshParams.Angle = angle;
+    meshParams.InParallel = missing.size() > 1;
+    BRepMesh_IncrementalMesh mesher(changed, meshParams);
+
+    for (const TopoDS_Face &face : missing)
+    {
+        TopLoc_Location location;
+        const Handle(Poly_Triangulation) &triangulation =
+            BRep_Tool::Triangulation(face, location);
+        if (!triangulation.IsNull() && !triangulation->HasNormals())
+        {
+            BRepLib_ToolTriangulatedShape::ComputeNormals(face, triangulation);
+        }
+    }
+    stats.remeshed = int(missing.size());
+    return stats;
+}
+
+// float positions and normals per node and int indices in the shaded
+// presentation
+void OccMeshPipeline::addTriangulationBytes(const Handle(Poly_Triangulation) & triangulation,
+                                            uint64_t &triangulationBytes,
+                                            uint64_t &presentationBytes)
+{
+    const uint64_t nodes = uint64_t(triangulation->NbNodes());
+    const uint64_t triangles = uint64_t(triangulation->NbTriangles());
+    triangulationBytes += nodes * 3 * sizeof(double) + triangles * 3 * sizeof(int);
+    if (triangulation->HasUVNodes())
+    {
+        triangulationBytes += nodes * 2 * sizeof(double);
+    }
+    if (triangulation->HasNormals())
+    {
+        triangulationBytes += nodes * 3 * sizeof(float);
+    }
+    presentationBytes += nodes * 6 * sizeof(float) + triangles * 3 * sizeof(int);
+}
+
+void OccMeshPipeline::addMeshBytes(const TopoDS_Shape &shape, uint64_t &triangulationBytes,
+                                   uint64_t &presentationBytes)
+{
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+    for (int i = 1; i <= faces.Extent(); ++i)
+    {
+        TopLoc_Location location;
+        const Handle(Poly_Triangulation) &triangulation =
+            BRep_Tool::Triangulation(TopoDS::Face(faces(i)), location);
+        if (!triangulation.IsNull())
+        {
+            addTriangulationBytes(triangulation, triangulationBytes, presentationBytes);
+        }
+    }
+}
+
+} // namespace geotoys
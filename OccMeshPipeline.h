@@ -0,0 +1,211 @@
+#ifndef OCCMESHPIPELINE_H
+#define OCCMESHPIPELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <QThreadPool>
+
+#include <AIS_Shape.hxx>
+#include <Quantity_Color.hxx>
+#include <Poly_Triangulation.hxx>
+#include <Select3D_SensitiveEntity.hxx>
+#include <SelectMgr_Selection.hxx>
+#include <Standard_Handle.hxx>
+#include <TopoDS_Shape.hxx>
+
+#include "OccMeshCache.h"
+
+namespace geotoys
+{
+
+// Parameters passed to BRepMesh_IncrementalMesh by the worker threads
+struct OccMeshParameters
+{
+    // Chordal deflection relative to the largest bounding box extent
+    double deviation_coefficient = 0.001;
+    // Angular deflection in radians, 20 degrees like the AIS default
+    double deviation_angle = 0.3490658503988659;
+    // Number of triangulations per shape, each level lod_factor times coarser
+    // than the previous one; 1 disables level of detail
+    int lod_levels = 3;
+    double lod_factor = 4.0;
+};
+
+struct OccMeshJob
+{
+    std::string id;
+    uint64_t generation = 0;
+    TopoDS_Shape shape;
+    Quantity_Color color;
+    bool display = true;
+    // part shared by assembly instances, id is the prototype key
+    bool prototype = false;
+    // Update of a displayed shape: faces unchanged since previous_source
+    // take the triangulation of previous, its meshed copy, see
+    // remeshShape(). Level 0 keeps the given deflection so that the
+    // presentation can reuse the chunks of unchanged faces.
+    TopoDS_Shape previous;
+    TopoDS_Shape previous_source;
+    double deflection = 0.0;
+    // coarser levels of previous, index 0 unused. Their unchanged faces
+    // keep the coarse triangulation as well.
+    std::vector<TopoDS_Shape> previous_levels;
+};
+
+struct OccMeshResult
+{
+    std::string id;
+    uint64_t generation = 0;
+    Handle(AIS_Shape) ais_shape;
+    bool display = true;
+    bool prototype = false;
+    double mesh_ms = 0.0;
+    bool cache_hit = false;
+    // estimated memory of all levels, counted off the render thread
+    uint64_t triangulation_bytes = 0;
+    uint64_t presentation_bytes = 0;
+    // the job had a previous shape, the displayed object takes over the
+    // shapes and levels of ais_shape
+    bool update = false;
+    // meshing threw, ais_shape is null
+    bool failed = false;
+    std::string error;
+};
+
+// Sensitive entities of a displayed shape, built off the render thread
+struct OccSelectionJob
+{
+    std::string id;
+    uint64_t generation = 0;
+    Handle(AIS_Shape) ais_shape;
+    // copy of the shape, the AIS object may be updated meanwhile
+    TopoDS_Shape shape;
+    double deflection = 0.0;
+    double angle = 0.0;
+    bool prototype = false;
+    // entities of the previous selection of an updated shape, faces keeping
+    // their triangulation keep their entity and only the others are built
+    std::vector<Handle(Select3D_SensitiveEntity)> reuse;
+};
+
+struct OccSelectionResult
+{
+    std::string id;
+    uint64_t generation = 0;
+    Handle(AIS_Shape) ais_shape;
+    // whole shape selection (mode 0) with prebuilt entity BVHs
+    Handle(SelectMgr_Selection) selection;
+    double build_ms = 0.0;
+    bool prototype = false;
+};
+
+// Faces of an edited shape, see OccMeshPipeline::remeshShape()
+struct OccRemeshStats
+{
+    int faces = 0;
+    // triangulation kept on a shared face or taken from an identical one
+    int reused = 0;
+    int remeshed = 0;
+};
+
+// Worker pool which tessellates shapes and prepares AIS_Shape objects off the
+// render thread. Results are collected by the owner with takeFinished().
+// Jobs mesh a topology copy of their shape: shapes of different jobs may
+// share faces, and a face is only ever written by the job owning the copy.
+class OccMeshPipeline
+{
+public:
+    explicit OccMeshPipeline(int max_threads = 0);
+    ~OccMeshPipeline();
+
+    OccMeshPipeline(const OccMeshPipeline &) = delete;
+    OccMeshPipeline &operator=(const OccMeshPipeline &) = delete;
+
+    void setMeshParameters(const OccMeshParameters &params);
+    OccMeshParameters meshParameters() const;
+
+    // Optional persistent triangulation cache, nullptr disables it
+    void setCache(std::shared_ptr<OccMeshCache> cache);
+    std::shared_ptr<OccMeshCache> cache() const;
+
+    // Called from a worker thread each time a job has been finished
+    void setFinishedCallback(std::function<void()> callback);
+
+    // Thread-safe, may be called from any thread
+    void submit(OccMeshJob job);
+    std::vector<OccMeshResult> takeFinished(size_t max_count);
+
+    size_t inFlightCount() const
+    {
+        return in_flight_.load();
+    }
+    bool hasFinished() const;
+
+    // Selection structures are collected separately, they follow display
+    void submitSelection(OccSelectionJob job);
+    std::vector<OccSelectionResult> takeSelections(size_t max_count);
+    bool hasSelections() const;
+
+    // Other background work of the scene shares the pool, e.g. file writes
+    void start(std::function<void()> task);
+
+    // Block until all submitted jobs are done
+    void waitForDone();
+
+    // Mesh the job on the calling thread, failures are reported in the result
+    OccMeshResult prepare(const OccMeshJob &job);
+
+    // Returns true when the triangulation came from the cache
+    static bool meshShape(const TopoDS_Shape &shape, double deflection,
+                          double angle, const std::shared_ptr<OccMeshCache> &cache);
+    // Face of previous matching each face of shape, an edited version of
+    // previousSource: index in the face map of previous or 0, indexed like
+    // the face map of shape. Faces sharing their TShape with previousSource
+    // match without looking at the geometry, previous must be a copy of it.
+    static std::vector<int> matchFaces(const TopoDS_Shape &previousSource,
+                                       const TopoDS_Shape &previous,
+                                       const TopoDS_Shape &shape);
+    // Incremental meshShape(): faces whose twin in previous is meshed with
+    // this deflection take its triangulation, only the others are meshed.
+    // shape must have the face order of the shape given to matchFaces().
+    static OccRemeshStats remeshShape(const TopoDS_Shape &previous,
+                                      const std::vector<int> &twins,
+                                      const TopoDS_Shape &shape, double deflection,
+                                      double angle);
+
+    // Estimated bytes of the triangulations and of their presentation
+    static void addTriangulationBytes(const Handle(Poly_Triangulation) & triangulation,
+                                      uint64_t &triangulationBytes,
+                                      uint64_t &presentationBytes);
+    static void addMeshBytes(const TopoDS_Shape &shape, uint64_t &triangulationBytes,
+                             uint64_t &presentationBytes);
+
+private:
+    OccMeshResult run(const OccMeshJob &job, const OccMeshParameters &params,
+                      const std::shared_ptr<OccMeshCache> &cache);
+    // run() with exceptions turned into a failed result
+    OccMeshResult runGuarded(const OccMeshJob &job, const OccMeshParameters &params,
+                             const std::shared_ptr<OccMeshCache> &cache);
+    static OccMeshResult failedResult(const OccMeshJob &job, const char *error);
+
+private:
+    QThreadPool pool_;
+    mutable std::mutex mutex_;
+    std::deque<OccMeshResult> finished_;
+    std::deque<OccSelectionResult> selections_;
+    OccMeshParameters params_;
+    std::shared_ptr<OccMeshCache> cache_;
+    std::function<void()> finished_callback_;
+    std::atomic<size_t> in_flight_{0};
+};
+
+} // namespace geotoys
+
+#endif // OCCMESHPIPELINE_H
@@ -0,0 +1,88 @@
+#include "OccRenderStats.h"
+
+#include <algorithm>
+
+namespace geotoys
+{
+
+OccRenderStats::OccRenderStats(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void OccRenderStats::addFrame(const OccFrameTimings &frame)
+{
+    latest_ = frame;
+
+    // timings and counters of a skipped pass are stale, keep the drawn ones
+    if (frame.skipped)
+    {
+        ++frames_skipped_;
+        Q_EMIT updated();
+        return;
+    }
+    ++frames_rendered_;
+    last_ = frame;
+    window_.push_back(frame);
+    if (window_.size() > size_t(WINDOW_SIZE))
+    {
+        window_.pop_front();
+    }
+    Q_EMIT updated();
+}
+
+void OccRenderStats::reset()
+{
+    window_.clear();
+    last_ = OccFrameTimings();
+    frames_rendered_ = 0;
+    frames_skipped_ = 0;
+    latest_ = OccFrameTimings();
+    Q_EMIT updated();
+}
+
+double OccRenderStats::synchronizeMs() const
+{
+    return average(&OccFrameTimings::synchronize_ms);
+}
+
+double OccRenderStats::fboMs() const
+{
+    return average(&OccFrameTimings::fbo_ms);
+}
+
+double OccRenderStats::flushMs() const
+{
+    return average(&OccFrameTimings::flush_ms);
+}
+
+double OccRenderStats::renderMs() const
+{
+    return average(&OccFrameTimings::render_ms);
+}
+
+double OccRenderStats::renderMsMax() const
+{
+    double result = 0.0;
+    for (const OccFrameTimings &frame : window_)
+    {
+        result = std::max(result, frame.render_ms);
+    }
+    return result;
+}
+
+double OccRenderStats::average(double OccFrameTimings::*field) const
+{
+    if (window_.empty())
+    {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (const OccFrameTimings &frame : window_)
+    {
+        sum += frame.*field;
+    }
+    return sum / double(window_.size());
+}
+
+} // namespace geotoys
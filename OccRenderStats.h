@@ -0,0 +1,146 @@
+#ifndef OCCRENDERSTATS_H
+#define OCCRENDERSTATS_H
+
+#include <cstdint>
+#include <deque>
+
+#include <QObject>
+
+namespace geotoys
+{
+
+// Measurements of one render pass, collected on the render thread
+struct OccFrameTimings
+{
+    double synchronize_ms = 0.0;
+    // wrap of the Qt FBO and view resize
+    double fbo_ms = 0.0;
+    double flush_ms = 0.0;
+    double render_ms = 0.0;
+    uint64_t triangles = 0;
+    uint64_t elements = 0;
+    // render pass without a redraw of the OCCT view
+    bool skipped = false;
+    // shapes displayed but not pickable yet, and the mean delay until they are
+    uint64_t selection_pending = 0;
+    double selection_lag_ms = 0.0;
+    // estimated scene memory, see OccMemoryStats
+    uint64_t triangulation_bytes = 0;
+    uint64_t triangulation_peak_bytes = 0;
+    uint64_t presentation_bytes = 0;
+    uint64_t presentation_peak_bytes = 0;
+    uint64_t evicted_shapes = 0;
+    // objects inside and outside the view volume, see OccCullingStats
+    uint64_t objects_drawn = 0;
+    uint64_t objects_culled = 0;
+};
+
+// Rolling frame statistics for QML and tests. Lives on the GUI thread, the
+// renderer posts one OccFrameTimings per render pass with a queued call.
+// Timings are averaged over the last WINDOW_SIZE drawn passes.
+class OccRenderStats : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(double synchronizeMs READ synchronizeMs NOTIFY updated)
+    Q_PROPERTY(double fboMs READ fboMs NOTIFY updated)
+    Q_PROPERTY(double flushMs READ flushMs NOTIFY updated)
+    Q_PROPERTY(double renderMs READ renderMs NOTIFY updated)
+    Q_PROPERTY(double renderMsMax READ renderMsMax NOTIFY updated)
+    Q_PROPERTY(qint64 triangles READ triangles NOTIFY updated)
+    Q_PROPERTY(qint64 elements READ elements NOTIFY updated)
+    Q_PROPERTY(qint64 framesRendered READ framesRendered NOTIFY updated)
+    Q_PROPERTY(qint64 framesSkipped READ framesSkipped NOTIFY updated)
+    Q_PROPERTY(qint64 selectionPending READ selectionPending NOTIFY updated)
+    Q_PROPERTY(double selectionLagMs READ selectionLagMs NOTIFY updated)
+    Q_PROPERTY(qint64 triangulationBytes READ triangulationBytes NOTIFY updated)
+    Q_PROPERTY(qint64 triangulationPeakBytes READ triangulationPeakBytes NOTIFY updated)
+    Q_PROPERTY(qint64 presentationBytes READ presentationBytes NOTIFY updated)
+    Q_PROPERTY(qint64 presentationPeakBytes READ presentationPeakBytes NOTIFY updated)
+    Q_PROPERTY(qint64 evictedShapes READ evictedShapes NOTIFY updated)
+    Q_PROPERTY(qint64 objectsDrawn READ objectsDrawn NOTIFY updated)
+    Q_PROPERTY(qint64 objectsCulled READ objectsCulled NOTIFY updated)
+
+public:
+    static const int WINDOW_SIZE = 60;
+
+    explicit OccRenderStats(QObject *parent = nullptr);
+
+    void addFrame(const OccFrameTimings &frame);
+    Q_INVOKABLE void reset();
+
+    double synchronizeMs() const;
+    double fboMs() const;
+    double flushMs() const;
+    double renderMs() const;
+    double renderMsMax() const;
+    qint64 triangles() const
+    {
+        return qint64(last_.triangles);
+    }
+    qint64 elements() const
+    {
+        return qint64(last_.elements);
+    }
+    qint64 framesRendered() const
+    {
+        return frames_rendered_;
+    }
+    qint64 framesSkipped() const
+    {
+        return frames_skipped_;
+    }
+    qint64 selectionPending() const
+    {
+        return qint64(latest_.selection_pending);
+    }
+    double selectionLagMs() const
+    {
+        return latest_.selection_lag_ms;
+    }
+    qint64 triangulationBytes() const
+    {
+        return qint64(latest_.triangulation_bytes);
+    }
+    qint64 triangulationPeakBytes() const
+    {
+        return qint64(latest_.triangulation_peak_bytes);
+    }
+    qint64 presentationBytes() const
+    {
+        return qint64(latest_.presentation_bytes);
+    }
+    qint64 presentationPeakBytes() const
+    {
+        return qint64(latest_.presentation_peak_bytes);
+    }
+    qint64 evictedShapes() const
+    {
+        return qint64(latest_.evicted_shapes);
+    }
+    qint64 objectsDrawn() const
+    {
+        return qint64(latest_.objects_drawn);
+    }
+    qint64 objectsCulled() const
+    {
+        return qint64(latest_.objects_culled);
+    }
+
+Q_SIGNALS:
+    void updated();
+
+private:
+    double average(double OccFrameTimings::*field) const;
+
+private:
+    std::deque<OccFrameTimings> window_;
+    OccFrameTimings last_;
+    qint64 frames_rendered_ = 0;
+    qint64 frames_skipped_ = 0;
+    // selection, memory and culling fields of the latest pass, skipped or not
+    OccFrameTimings latest_;
+};
+
+} // namespace geotoys
+
+#endif // OCCRENDERSTATS_H
@@ -0,0 +1,60 @@
+#include "OccResolutionController.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace geotoys
+{
+
+namespace
+{
+// weight of the newest sample in the smoothed frame time
+const double SMOOTHING = 0.3;
+// scale changes reallocate OCCT offscreen buffers, keep them coarse
+const double SCALE_STEP = 1.0 / 16.0;
+} // namespace
+
+void OccResolutionController::setSettings(const OccResolutionSettings &settings)
+{
+    settings_ = settings;
+    settings_.min_scale = std::clamp(settings_.min_scale, 0.1, 1.0);
+    settings_.max_scale = std::clamp(settings_.max_scale, settings_.min_scale, 2.0);
+    settings_.target_frame_ms = std::max(settings_.target_frame_ms, 1.0);
+    scale_ = clampScale(scale_);
+}
+
+double OccResolutionController::update(double frame_ms, bool interacting)
+{
+    if (!settings_.enabled || !interacting)
+    {
+        smoothed_ms_ = 0.0;
+        scale_ = settings_.enabled ? settings_.max_scale : 1.0;
+        return scale_;
+    }
+
+    smoothed_ms_ = smoothed_ms_ <= 0.0
+                       ? frame_ms
+                       : smoothed_ms_ + SMOOTHING * (frame_ms - smoothed_ms_);
+
+    // fill rate cost grows with the square of the scale
+    const double ratio = settings_.target_frame_ms / std::max(smoothed_ms_, 0.1);
+    if (ratio > 0.9 && ratio < 1.3)
+    {
+        return scale_;
+    }
+    double desired = scale_ * std::sqrt(ratio);
+    // move halfway to avoid oscillation
+    desired = scale_ + 0.5 * (desired - scale_);
+    // snap down when over budget, rounding would undo steps below SCALE_STEP
+    desired = ratio < 1.0 ? std::floor(desired / SCALE_STEP) * SCALE_STEP
+                          : std::round(desired / SCALE_STEP) * SCALE_STEP;
+    scale_ = clampScale(desired);
+    return scale_;
+}
+
+double OccResolutionController::clampScale(double scale) const
+{
+    return std::clamp(scale, settings_.min_scale, settings_.max_scale);
+}
+
+} // namespace geotoys
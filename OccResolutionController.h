@@ -0,0 +1,52 @@
+#ifndef OCCRESOLUTIONCONTROLLER_H
+#define OCCRESOLUTIONCONTROLLER_H
+
+namespace geotoys
+{
+
+struct OccResolutionSettings
+{
+    bool enabled = false;
+    // frame time budget in milliseconds
+    double target_frame_ms = 16.0;
+    double min_scale = 0.5;
+    double max_scale = 1.0;
+};
+
+// Closed-loop controller for Graphic3d_RenderingParams::RenderResolutionScale.
+// While the view is interacting or animating the scale follows the smoothed
+// render time of the view towards the budget; once the view goes idle the
+// maximal scale is restored for one full resolution frame.
+class OccResolutionController
+{
+public:
+    void setSettings(const OccResolutionSettings &settings);
+    const OccResolutionSettings &settings() const
+    {
+        return settings_;
+    }
+
+    // Feed the render time of the last frame, returns the scale for the next one
+    double update(double frame_ms, bool interacting);
+
+    double scale() const
+    {
+        return scale_;
+    }
+    double smoothedFrameTime() const
+    {
+        return smoothed_ms_;
+    }
+
+private:
+    double clampScale(double scale) const;
+
+private:
+    OccResolutionSettings settings_;
+    double scale_ = 1.0;
+    double smoothed_ms_ = 0.0;
+};
+
+} // namespace geotoys
+
+#endif // OCCRESOLUTIONCONTROLLER_H
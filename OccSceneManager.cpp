@@ -1,31 +1,106 @@
 #include "OccSceneManager.h"
 
-#include <iostream>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
 
 #include <AIS_Shape.hxx>
 #include <AIS_ViewCube.hxx>
+#include <Graphic3d_Camera.hxx>
 #include <Graphic3d_TransformPers.hxx>
 #include <Message.hxx>
 #include <Quantity_Color.hxx>
+#include <SelectMgr_SelectionManager.hxx>
+#include <SelectMgr_SensitiveEntity.hxx>
+#include <Standard_Version.hxx>
 #include <V3d_View.hxx>
 
+#include "OccBinaryMesh.h"
+#include "OccLodShape.h"
+#include "OccLog.h"
+#include "OccTrace.h"
+
 namespace geotoys
 {
 
+namespace
+{
+// shape given by the caller, the AIS object displays a meshed copy of it
+TopoDS_Shape sourceShape(const Handle(AIS_Shape) & aisShape)
+{
+    Handle(OccLodShape) lodShape = Handle(OccLodShape)::DownCast(aisShape);
+    return lodShape.IsNull() ? aisShape->Shape() : lodShape->source();
+}
+
+// group of an id or of a group, "" for the root
+std::string parentPath(const std::string &path)
+{
+    const size_t slash = path.rfind('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash);
+}
+
+// Conservative: true only when all corners lie beyond the same side of the
+// view volume. Boxes reaching behind a perspective eye are kept, the
+// projection flips there.
+bool isOutside(const Handle(Graphic3d_Camera) & camera, const Bnd_Box &box)
+{
+    if (box.IsVoid() || box.IsOpen())
+    {
+        return false;
+    }
+    double xmin, ymin, zmin, xmax, ymax, zmax;
+    box.Get(xmin, ymin, zmin, xmax, ymax, zmax);
+    const gp_Vec direction(camera->Direction());
+    int left = 0;
+    int right = 0;
+    int bottom = 0;
+    int top = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        const gp_Pnt corner((i & 1) ? xmax : xmin, (i & 2) ? ymax : ymin,
+                            (i & 4) ? zmax : zmin);
+        if (!camera->IsOrthographic() &&
+            gp_Vec(camera->Eye(), corner).Dot(direction) <= 0.0)
+        {
+            return false;
+        }
+        const gp_Pnt projected = camera->Project(corner);
+        left += projected.X() < -1.0 ? 1 : 0;
+        right += projected.X() > 1.0 ? 1 : 0;
+        bottom += projected.Y() < -1.0 ? 1 : 0;
+        top += projected.Y() > 1.0 ? 1 : 0;
+    }
+    return left == 8 || right == 8 || bottom == 8 || top == 8;
+}
+} // namespace
+
 OccSceneManager::OccSceneManager(QObject *parent)
     : QObject(parent)
     , viewcube_visible_(true)
+    , mesh_pipeline_(std::make_unique<OccMeshPipeline>())
 {
+    mesh_pipeline_->setFinishedCallback([this]() { Q_EMIT meshFinished(); });
+    clock_.start();
 }
 
 OccSceneManager::~OccSceneManager()
 {
+    mesh_pipeline_->setFinishedCallback(nullptr);
+    mesh_pipeline_->waitForDone();
     clearAllShapes();
 }
 
 void OccSceneManager::setContext(const Handle(AIS_InteractiveContext) & context)
 {
     context_ = context;
+#if OCC_VERSION_HEX >= 0x070600
+    // per object BVHs of the selector are built by OCCT's own threads
+    if (!context_.IsNull())
+    {
+        context_->MainSelector()->SetToPrebuildBVH(true);
+    }
+#endif
 }
 
 void OccSceneManager::setView(const Handle(V3d_View) & view)
@@ -36,82 +111,256 @@ void OccSceneManager::setView(const Handle(V3d_View) & view)
 bool OccSceneManager::addShape(const std::string &id, const TopoDS_Shape &shape,
                                const Quantity_Color &color, bool display)
 {
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::addShape");
     if (context_.IsNull())
     {
-        std::cerr << "Context is null, cannot add shape:" << id << std::endl;
+        qCWarning(lcOccScene) << "Context is null, cannot add shape:" << id.c_str();
         return false;
     }
 
-    auto it = shapes_.find(id);
-    if (it != shapes_.end())
+    beginUpdate();
+    if (shapes_.count(id) > 0 || instances_.count(id) > 0 || meshes_.count(id) > 0 ||
+        dormant_.count(id) > 0)
     {
         removeShape(id);
     }
+    cancelPending(id);
 
-    Handle(AIS_Shape) aisShape = new AIS_Shape(shape);
-    aisShape->SetColor(color);
+    if (!display)
+    {
+        // built when first shown, see setShapeVisible()
+        Dormant &dormant = dormant_[id];
+        dormant.shape = shape;
+        dormant.color = color;
+        linkToGroup(id);
+        ++batch_added_;
+        endUpdate();
+        return true;
+    }
+
+    Handle(AIS_Shape) aisShape;
+    if (mesh_pipeline_->cache())
+    {
+        // mesh now to reuse a cached triangulation instead of meshing in AIS
+        OccMeshJob job;
+        job.id = id;
+        job.shape = shape;
+        job.color = color;
+        aisShape = mesh_pipeline_->prepare(job).ais_shape;
+    }
+    // no cache, or meshing failed and AIS gets its own attempt
+    if (aisShape.IsNull())
+    {
+        aisShape = new AIS_Shape(shape);
+        aisShape->SetColor(color);
+    }
 
     shapes_[id] = aisShape;
+    displayShape(id, aisShape);
+    linkToGroup(id);
+    ++batch_added_;
+    view_dirty_ = true;
+    endUpdate();
+    return true;
+}
 
-    if (display)
+size_t OccSceneManager::addShapes(const std::vector<OccShapeDesc> &shapes)
+{
+    size_t count = 0;
+    beginUpdate();
+    for (const OccShapeDesc &desc : shapes)
     {
-        context_->Display(aisShape, AIS_Shaded, 0, false);
+        if (addShape(desc.id, desc.shape, desc.color, desc.display))
+        {
+            ++count;
+        }
     }
-    view_->Invalidate();
-    view_->InvalidateImmediate();
-    std::cout << "Added shape:" << id << std::endl;
-    return true;
+    endUpdate();
+    return count;
 }
 
 bool OccSceneManager::removeShape(const std::string &id)
 {
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::removeShape");
+    const bool wasPending = cancelPending(id);
+    selection_pending_.erase(id);
+    if (instances_.count(id) > 0)
+    {
+        beginUpdate();
+        removeInstance(id);
+        endUpdate();
+        return true;
+    }
+    if (removeMesh(id))
+    {
+        return true;
+    }
+    if (dormant_.erase(id) > 0)
+    {
+        unlinkFromGroup(id);
+        ++batch_removed_;
+        return true;
+    }
     auto it = shapes_.find(id);
     if (it == shapes_.end())
     {
-        return false;
+        return wasPending;
     }
 
+    beginUpdate();
     Handle(AIS_Shape) shape = it->second;
     if (!context_.IsNull() && !shape.IsNull())
     {
-        context_->Erase(shape, false);
         context_->Remove(shape, false);
-
-        if (!view_.IsNull())
-        {
-            view_->Invalidate();
-            view_->InvalidateImmediate();
-        }
+        view_dirty_ = true;
     }
 
+    untrackShape(id);
+    unlinkFromGroup(id);
     shapes_.erase(it);
-    std::cout << "Removed shape:" << id << std::endl;
+    ++batch_removed_;
+    endUpdate();
     return true;
 }
 
+size_t OccSceneManager::removeShapes(const std::vector<std::string> &ids)
+{
+    size_t count = 0;
+    beginUpdate();
+    for (const std::string &id : ids)
+    {
+        if (removeShape(id))
+        {
+            ++count;
+        }
+    }
+    endUpdate();
+    return count;
+}
+
 bool OccSceneManager::updateShape(const std::string &id,
                                   const TopoDS_Shape &shape)
 {
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::updateShape");
+    auto instanceIt = instances_.find(id);
+    if (instanceIt != instances_.end())
+    {
+        // the instance leaves its part and becomes a standalone shape, it
+        // stays displayed until the new one is meshed
+        addShapeAsync(id, shape, instanceIt->second.color, true);
+        return true;
+    }
+
+    auto dormantIt = dormant_.find(id);
+    if (dormantIt != dormant_.end())
+    {
+        dormantIt->second.shape = shape;
+        if (dormantIt->second.requested)
+        {
+            // remesh the new shape for the pending display
+            submitShape(id, shape, dormantIt->second.color);
+        }
+        return true;
+    }
+
     auto it = shapes_.find(id);
-    if (it == shapes_.end())
+    if (it == shapes_.end() || it->second.IsNull())
     {
-        return addShape(id, shape, Quantity_NOC_YELLOW, true);
+        addShapeAsync(id, shape, Quantity_NOC_YELLOW, true);
+        return true;
     }
 
+    // the old shape stays displayed while the new one is meshed in
+    // background, commitUpdate() then swaps them
     Handle(AIS_Shape) aisShape = it->second;
-    if (!aisShape.IsNull())
+    OccMeshJob job;
+    job.id = id;
+    job.generation = next_generation_++;
+    job.shape = shape;
+    aisShape->Color(job.color);
+    Handle(OccLodShape) lodShape = Handle(OccLodShape)::DownCast(aisShape);
+    if (!lodShape.IsNull())
     {
-        aisShape->SetShape(shape);
-        context_->Redisplay(aisShape, false);
-        return true;
+        // only faces changed by the edit are meshed, the presentation
+        // refills only their chunks
+        job.previous = lodShape->Shape();
+        job.previous_source = lodShape->source();
+        job.previous_levels.resize(size_t(lodShape->nbLevels()));
+        for (int level = 1; level < lodShape->nbLevels(); ++level)
+        {
+            job.previous_levels[level] = lodShape->levelShape(level);
+        }
+        job.deflection = lodShape->levelDeflection(0);
     }
+    pending_[id] = job.generation;
+    mesh_pipeline_->submit(std::move(job));
+    return true;
+}
 
-    return false;
+void OccSceneManager::beginUpdate()
+{
+    ++update_depth_;
+}
+
+void OccSceneManager::endUpdate()
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::endUpdate");
+    if (update_depth_ == 0 || --update_depth_ > 0)
+    {
+        return;
+    }
+
+    enforceMemoryBudget();
+
+    if (view_dirty_ && !view_.IsNull())
+    {
+        view_->Invalidate();
+        view_->InvalidateImmediate();
+    }
+    view_dirty_ = false;
+
+    if (batch_added_ > 0 || batch_removed_ > 0)
+    {
+        qCDebug(lcOccScene) << "Scene update: added" << batch_added_ << "removed"
+                            << batch_removed_ << "shapes";
+    }
+    batch_added_ = 0;
+    batch_removed_ = 0;
 }
 
 bool OccSceneManager::setShapeColor(const std::string &id,
                                     const Quantity_Color &color)
 {
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::setShapeColor");
+    auto instanceIt = instances_.find(id);
+    if (instanceIt != instances_.end())
+    {
+        Instance &instance = instanceIt->second;
+        instance.color = color;
+        if (!instance.object.IsNull())
+        {
+            applyInstanceColor(instance);
+            context_->Redisplay(instance.object, false);
+            view_dirty_ = true;
+        }
+        return true;
+    }
+
+    auto meshIt = meshes_.find(id);
+    if (meshIt != meshes_.end())
+    {
+        context_->SetColor(meshIt->second, color, false);
+        view_dirty_ = true;
+        return true;
+    }
+
+    auto dormantIt = dormant_.find(id);
+    if (dormantIt != dormant_.end())
+    {
+        dormantIt->second.color = color;
+        return true;
+    }
+
     auto it = shapes_.find(id);
     if (it == shapes_.end())
     {
@@ -132,38 +381,1353 @@ bool OccSceneManager::setShapeColor(const std::string &id,
     return false;
 }
 
-Handle(AIS_Shape) OccSceneManager::getShape(const std::string &id) const
+void OccSceneManager::addShapeAsync(const std::string &id,
+                                    const TopoDS_Shape &shape,
+                                    const Quantity_Color &color, bool display)
 {
-    auto it = shapes_.find(id);
-    if (it != shapes_.end())
+    if (!display)
     {
-        return it->second;
+        // nothing to mesh before the shape is shown
+        beginUpdate();
+        removeShape(id);
+        Dormant &dormant = dormant_[id];
+        dormant.shape = shape;
+        dormant.color = color;
+        linkToGroup(id);
+        ++batch_added_;
+        endUpdate();
+        Q_EMIT shapeReady(QString::fromStdString(id));
+        return;
     }
-    return Handle(AIS_Shape)();
+
+    dormant_.erase(id);
+    submitShape(id, shape, color);
 }
 
-std::vector<std::string> OccSceneManager::getAllShapeIds() const
+void OccSceneManager::submitShape(const std::string &id, const TopoDS_Shape &shape,
+                                  const Quantity_Color &color)
 {
-    std::vector<std::string> ids;
-    ids.reserve(shapes_.size());
-    for (const auto &pair : shapes_)
+    OccMeshJob job;
+    job.id = id;
+    job.generation = next_generation_++;
+    job.shape = shape;
+    job.color = color;
+
+    pending_[id] = job.generation;
+    mesh_pipeline_->submit(std::move(job));
+}
+
+void OccSceneManager::addShapesAsync(const std::vector<OccShapeDesc> &shapes)
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::addShapesAsync");
+    for (const OccShapeDesc &desc : shapes)
     {
-        ids.push_back(pair.first);
+        addShapeAsync(desc.id, desc.shape, desc.color, desc.display);
     }
-    return ids;
 }
 
-void OccSceneManager::clearAllShapes()
+bool OccSceneManager::isShapeReady(const std::string &id) const
 {
-    if (!context_.IsNull())
+    return pending_.find(id) == pending_.end() &&
+           (shapes_.find(id) != shapes_.end() || dormant_.find(id) != dormant_.end());
+}
+
+bool OccSceneManager::hasPendingShapes() const
+{
+    return !pending_.empty() || !prototype_pending_.empty();
+}
+
+void OccSceneManager::setMeshParameters(const OccMeshParameters &params)
+{
+    mesh_pipeline_->setMeshParameters(params);
+}
+
+void OccSceneManager::setMeshCache(std::shared_ptr<OccMeshCache> cache)
+{
+    mesh_pipeline_->setCache(std::move(cache));
+}
+
+OccMeshCacheStats OccSceneManager::meshCacheStats() const
+{
+    std::shared_ptr<OccMeshCache> cache = mesh_pipeline_->cache();
+    return cache ? cache->stats() : OccMeshCacheStats();
+}
+
+bool OccSceneManager::commitFinishedShapes(double budget_ms)
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::commitFinishedShapes");
+    if (context_.IsNull() ||
+        (!mesh_pipeline_->hasFinished() && !mesh_pipeline_->hasSelections()))
     {
-        context_->RemoveAll(false);
-        // 强制更新视图
-        if (!view_.IsNull())
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    beginUpdate();
+    // selections first, activation is cheap and makes shapes pickable
+    while (double(timer.nsecsElapsed()) / 1.0e6 < budget_ms)
+    {
+        std::vector<OccSelectionResult> selections = mesh_pipeline_->takeSelections(1);
+        if (selections.empty())
+        {
+            break;
+        }
+        activateSelection(selections.front());
+    }
+    while (double(timer.nsecsElapsed()) / 1.0e6 < budget_ms)
+    {
+        std::vector<OccMeshResult> results = mesh_pipeline_->takeFinished(1);
+        if (results.empty())
+        {
+            break;
+        }
+
+        OccMeshResult &result = results.front();
+        if (result.failed)
+        {
+            commitFailure(result);
+            continue;
+        }
+        if (result.prototype)
+        {
+            commitPrototype(result);
+            continue;
+        }
+        auto pendingIt = pending_.find(result.id);
+        if (pendingIt == pending_.end() ||
+            pendingIt->second != result.generation)
+        {
+            // removed or replaced while meshing
+            continue;
+        }
+        pending_.erase(pendingIt);
+        auto visibleIt = pending_visible_.find(result.id);
+        if (visibleIt != pending_visible_.end())
+        {
+            // shown or hidden while meshing
+            result.display = visibleIt->second;
+            pending_visible_.erase(visibleIt);
+        }
+        if (result.update && commitUpdate(result))
+        {
+            Q_EMIT shapeReady(QString::fromStdString(result.id));
+            continue;
+        }
+        // replaces an instance or a mesh of the same id
+        removeInstance(result.id);
+        removeMesh(result.id);
+
+        auto dormantIt = dormant_.find(result.id);
+        if (dormantIt != dormant_.end())
+        {
+            // shown again, the color may have changed while meshing
+            result.ais_shape->SetColor(dormantIt->second.color);
+            dormant_.erase(dormantIt);
+        }
+        auto it = shapes_.find(result.id);
+        if (it != shapes_.end() && !it->second.IsNull())
+        {
+            context_->Remove(it->second, false);
+            untrackShape(result.id);
+        }
+        shapes_[result.id] = result.ais_shape;
+
+        if (result.display)
+        {
+            displayShape(result.id, result.ais_shape);
+        }
+        linkToGroup(result.id);
+        ++batch_added_;
+        view_dirty_ = true;
+        Q_EMIT shapeReady(QString::fromStdString(result.id));
+    }
+    endUpdate();
+
+    return mesh_pipeline_->hasFinished() || mesh_pipeline_->hasSelections();
+}
+
+bool OccSceneManager::commitUpdate(const OccMeshResult &result)
+{
+    auto it = shapes_.find(result.id);
+    Handle(OccLodShape) lodShape =
+        it != shapes_.end() ? Handle(OccLodShape)::DownCast(it->second) : nullptr;
+    Handle(OccLodShape) update = Handle(OccLodShape)::DownCast(result.ais_shape);
+    auto dormantIt = dormant_.find(result.id);
+    if (dormantIt != dormant_.end() && !dormantIt->second.requested)
+    {
+        // evicted while hidden, meshed again when shown
+        dormantIt->second.shape = sourceShape(result.ais_shape);
+        return true;
+    }
+    if (lodShape.IsNull() || update.IsNull())
+    {
+        // replaced meanwhile, displayed like a new shape
+        return false;
+    }
+
+    // the object is kept, every level refills only the chunks of changed
+    // faces. Levels dropped by changed mesh parameters are cleared.
+    const Handle(PrsMgr_PresentationManager) &prsMgr = context_->MainPrsMgr();
+    for (int level = update->nbLevels(); level < lodShape->nbLevels(); ++level)
+    {
+        prsMgr->Clear(lodShape, OccLodShape::displayMode(level));
+    }
+    if (lodShape->DisplayMode() != AIS_Shaded)
+    {
+        context_->SetDisplayMode(lodShape, AIS_Shaded, false);
+    }
+    lodShape->clearLevels(update->levelDeflection(0));
+    for (int level = 1; level < update->nbLevels(); ++level)
+    {
+        lodShape->addLevel(update->levelShape(level), update->levelDeflection(level));
+    }
+    // the selection is built again, unchanged faces keep their entities
+    std::vector<Handle(Select3D_SensitiveEntity)> reuse;
+    if (lodShape->HasSelection(0))
+    {
+        const Handle(SelectMgr_Selection) &selection = lodShape->Selection(0);
+        for (NCollection_Vector<Handle(SelectMgr_SensitiveEntity)>::Iterator entityIt(
+                 selection->Entities());
+             entityIt.More(); entityIt.Next())
+        {
+            reuse.push_back(entityIt.Value()->BaseSensitive());
+        }
+    }
+    selection_pending_.erase(result.id);
+    context_->Deactivate(lodShape);
+    context_->SelectionManager()->Remove(lodShape);
+
+    lodShape->SetShape(update->Shape());
+    lodShape->setSource(update->source());
+    touchObject(result.id);
+    // hidden shapes are recomputed when shown again
+    context_->Redisplay(lodShape, false);
+    if (context_->IsDisplayed(lodShape))
+    {
+        requestSelection(result.id, lodShape, false, std::move(reuse));
+        for (int level = 1; level < lodShape->nbLevels(); ++level)
+        {
+            prsMgr->Display(lodShape, OccLodShape::displayMode(level));
+            prsMgr->SetVisibility(lodShape, OccLodShape::displayMode(level), false);
+        }
+        lod_dirty_ = true;
+        qCDebug(lcOccScene) << "Update of" << result.id.c_str() << "reused"
+                            << lodShape->reusedChunks() << "chunks";
+    }
+    // counted by the worker, the faces are not walked here
+    recordMemory(result.id, result.triangulation_bytes, result.presentation_bytes);
+    view_dirty_ = true;
+    return true;
+}
+
+bool OccSceneManager::cancelPending(const std::string &id)
+{
+    pending_visible_.erase(id);
+    if (pending_.erase(id) == 0)
+    {
+        return false;
+    }
+    Q_EMIT shapeCancelled(QString::fromStdString(id));
+    return true;
+}
+
+void OccSceneManager::commitFailure(const OccMeshResult &result)
+{
+    if (result.prototype)
+    {
+        // the instances of the part stay hidden
+        auto pendingIt = prototype_pending_.find(result.id);
+        if (pendingIt != prototype_pending_.end() && pendingIt->second == result.generation)
+        {
+            prototype_pending_.erase(pendingIt);
+        }
+        return;
+    }
+    auto pendingIt = pending_.find(result.id);
+    if (pendingIt == pending_.end() || pendingIt->second != result.generation)
+    {
+        return;
+    }
+    pending_.erase(pendingIt);
+    pending_visible_.erase(result.id);
+    Q_EMIT shapeFailed(QString::fromStdString(result.id),
+                       QString::fromStdString(result.error));
+}
+
+void OccSceneManager::displayShape(const std::string &id,
+                                   const Handle(AIS_Shape) & aisShape)
+{
+    Handle(OccLodShape) lodShape = Handle(OccLodShape)::DownCast(aisShape);
+    if (lodShape.IsNull())
+    {
+        // not prepared by the pipeline, selection is computed by AIS
+        context_->Display(aisShape, AIS_Shaded, 0, false);
+        trackShape(id, aisShape);
+        return;
+    }
+
+    // selection mode -1: pickable once the background selection is adopted
+    context_->Display(lodShape, AIS_Shaded, -1, false);
+    requestSelection(id, lodShape);
+
+    // compute the coarser levels now and keep them hidden, switching the
+    // display mode later does not build any presentation
+    const Handle(PrsMgr_PresentationManager) &prsMgr = context_->MainPrsMgr();
+    for (int level = 1; level < lodShape->nbLevels(); ++level)
+    {
+        prsMgr->Display(lodShape, OccLodShape::displayMode(level));
+        prsMgr->SetVisibility(lodShape, OccLodShape::displayMode(level), false);
+    }
+    lod_dirty_ = true;
+    trackShape(id, lodShape);
+}
+
+void OccSceneManager::requestSelection(const std::string &id,
+                                       const Handle(AIS_Shape) & aisShape, bool prototype,
+                                       std::vector<Handle(Select3D_SensitiveEntity)> reuse)
+{
+    SelectionRequest &request =
+        (prototype ? prototype_selection_pending_ : selection_pending_)[id];
+    request.generation = next_generation_++;
+    request.displayed_ms = double(clock_.nsecsElapsed()) / 1.0e6;
+
+    OccSelectionJob job;
+    job.id = id;
+    job.generation = request.generation;
+    job.ais_shape = aisShape;
+    job.shape = aisShape->Shape();
+    job.deflection = aisShape->Attributes()->MaximalChordialDeviation();
+    job.angle = aisShape->Attributes()->DeviationAngle();
+    job.prototype = prototype;
+    job.reuse = std::move(reuse);
+    mesh_pipeline_->submitSelection(std::move(job));
+}
+
+void OccSceneManager::activateSelection(OccSelectionResult &result)
+{
+    auto &pendingMap = result.prototype ? prototype_selection_pending_ : selection_pending_;
+    auto pendingIt = pendingMap.find(result.id);
+    if (pendingIt == pendingMap.end() || pendingIt->second.generation != result.generation)
+    {
+        // removed, updated or hidden meanwhile
+        return;
+    }
+    const double lagMs =
+        double(clock_.nsecsElapsed()) / 1.0e6 - pendingIt->second.displayed_ms;
+    pendingMap.erase(pendingIt);
+
+    if (result.prototype)
+    {
+        activatePrototypeSelection(result, lagMs);
+        return;
+    }
+
+    auto it = shapes_.find(result.id);
+    if (it == shapes_.end() || it->second != result.ais_shape)
+    {
+        return;
+    }
+    Handle(OccLodShape) lodShape = Handle(OccLodShape)::DownCast(result.ais_shape);
+    lodShape->adoptSelection(result.selection);
+    if (context_->IsDisplayed(lodShape))
+    {
+        // hidden shapes are activated when shown again
+        context_->Activate(lodShape, 0);
+    }
+
+    recordSelectionLag(lagMs);
+    qCDebug(lcOccScene) << "Selection ready for" << result.id.c_str() << "built in"
+                        << result.build_ms << "ms, lag" << lagMs << "ms";
+}
+
+void OccSceneManager::activatePrototypeSelection(OccSelectionResult &result, double lagMs)
+{
+    auto it = prototypes_.find(result.id);
+    if (it == prototypes_.end() || it->second.ais != result.ais_shape)
+    {
+        return;
+    }
+
+    // connected instances derive their entities from the prototype selection
+    Prototype &prototype = it->second;
+    prototype.ais->adoptSelection(result.selection);
+    prototype.selectable = true;
+    for (const std::string &user : prototype.users)
+    {
+        auto instanceIt = instances_.find(user);
+        if (instanceIt != instances_.end() && !instanceIt->second.object.IsNull())
         {
-            view_->InvalidateImmediate();
+            context_->Activate(instanceIt->second.object, 0);
         }
     }
+
+    recordSelectionLag(lagMs);
+    qCDebug(lcOccScene) << "Selection ready for part" << result.id.c_str() << "with"
+                        << prototype.users.size() << "instances, lag" << lagMs << "ms";
+}
+
+void OccSceneManager::recordSelectionLag(double lagMs)
+{
+    OccSelectionStats &stats = selection_stats_;
+    ++stats.activated;
+    stats.last_lag_ms = lagMs;
+    stats.mean_lag_ms += (lagMs - stats.mean_lag_ms) / double(stats.activated);
+    stats.max_lag_ms = std::max(stats.max_lag_ms, lagMs);
+}
+
+OccSelectionStats OccSceneManager::selectionStats() const
+{
+    OccSelectionStats stats = selection_stats_;
+    stats.pending = selection_pending_.size() + prototype_selection_pending_.size();
+    return stats;
+}
+
+bool OccSceneManager::setShapeVisible(const std::string &id, bool visible)
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::setShapeVisible");
+    if (context_.IsNull())
+    {
+        return false;
+    }
+
+    auto dormantIt = dormant_.find(id);
+    if (dormantIt != dormant_.end())
+    {
+        Dormant &dormant = dormantIt->second;
+        if (visible && !dormant.requested)
+        {
+            // committed like any background shape, the record keeps the
+            // BRep until then in case it is hidden again meanwhile
+            submitShape(id, dormant.shape, dormant.color);
+            dormant.requested = true;
+        }
+        else if (!visible && dormant.requested)
+        {
+            cancelPending(id);
+            dormant.requested = false;
+        }
+        return true;
+    }
+
+    Handle(AIS_InteractiveObject) object;
+    auto it = shapes_.find(id);
+    if (it == shapes_.end())
+    {
+        object = getObject(id);
+        if (object.IsNull())
+        {
+            if (pending_.count(id) == 0)
+            {
+                return false;
+            }
+            // still meshing, applied when committed
+            pending_visible_[id] = visible;
+            return true;
+        }
+    }
+    else
+    {
+        object = it->second;
+    }
+    if (context_->IsDisplayed(object) == visible)
+    {
+        return true;
+    }
+
+    beginUpdate();
+    view_dirty_ = true;
+    touchObject(id);
+    if (it == shapes_.end())
+    {
+        // instances and meshes have no budget, they are only erased
+        if (visible)
+        {
+            auto instanceIt = instances_.find(id);
+            const bool selectable =
+                instanceIt != instances_.end() &&
+                prototypes_.at(instanceIt->second.prototype).selectable;
+            const int mode = instanceIt != instances_.end() ? AIS_Shaded : 0;
+            context_->Display(object, mode, selectable ? 0 : -1, false);
+        }
+        else
+        {
+            context_->Erase(object, false);
+        }
+        endUpdate();
+        return true;
+    }
+
+    auto memoryIt = shape_memory_.find(id);
+    if (!visible)
+    {
+        context_->Erase(object, false);
+        if (memoryIt != shape_memory_.end())
+        {
+            memoryIt->second.hidden = true;
+            memoryIt->second.lru = hidden_lru_.insert(hidden_lru_.end(), id);
+        }
+    }
+    else if (memoryIt == shape_memory_.end())
+    {
+        displayShape(id, it->second);
+    }
+    else
+    {
+        hidden_lru_.erase(memoryIt->second.lru);
+        memoryIt->second.hidden = false;
+        // the presentation is still computed, only shown again
+        Handle(OccLodShape) lodShape = Handle(OccLodShape)::DownCast(object);
+        const int mode =
+            lodShape.IsNull() ? AIS_Shaded : OccLodShape::displayMode(lodShape->activeLevel());
+        const bool selectable = selection_pending_.count(id) == 0;
+        context_->Display(object, mode, selectable ? 0 : -1, false);
+        lod_dirty_ = true;
+    }
+    // over budget, hidden shapes are evicted
+    endUpdate();
+    return true;
+}
+
+bool OccSceneManager::isShapeVisible(const std::string &id) const
+{
+    Handle(AIS_InteractiveObject) object = getObject(id);
+    return !context_.IsNull() && !object.IsNull() && context_->IsDisplayed(object);
+}
+
+void OccSceneManager::setMemoryBudget(uint64_t bytes)
+{
+    memory_.budget_bytes = bytes;
+    enforceMemoryBudget();
+}
+
+OccMemoryStats OccSceneManager::memoryStats() const
+{
+    OccMemoryStats stats = memory_;
+    stats.hidden_shapes = hidden_lru_.size();
+    // meshes are counted in the bytes but are not shapes
+    stats.visible_shapes = shape_memory_.size() - hidden_lru_.size() - meshes_.size();
+    stats.dormant_shapes = dormant_.size();
+    return stats;
+}
+
+void OccSceneManager::trackShape(const std::string &id, const Handle(AIS_Shape) & aisShape)
+{
+    uint64_t triangulation = 0;
+    uint64_t presentation = 0;
+    Handle(OccLodShape) lodShape = Handle(OccLodShape)::DownCast(aisShape);
+    if (lodShape.IsNull())
+    {
+        OccMeshPipeline::addMeshBytes(aisShape->Shape(), triangulation, presentation);
+    }
+    else
+    {
+        // the coarser levels are meshed copies with their own presentation
+        for (int level = 0; level < lodShape->nbLevels(); ++level)
+        {
+            OccMeshPipeline::addMeshBytes(lodShape->levelShape(level), triangulation,
+                                          presentation);
+        }
+    }
+
+    recordMemory(id, triangulation, presentation);
+}
+
+void OccSceneManager::trackMesh(const std::string &id, const Handle(AIS_Triangulation) & mesh)
+{
+    uint64_t triangulation = 0;
+    uint64_t presentation = 0;
+    if (!mesh->GetTriangulation().IsNull())
+    {
+        OccMeshPipeline::addTriangulationBytes(mesh->GetTriangulation(), triangulation,
+                                               presentation);
+    }
+    recordMemory(id, triangulation, presentation);
+}
+
+void OccSceneManager::recordMemory(const std::string &id, uint64_t triangulation,
+                                   uint64_t presentation)
+{
+    ShapeMemory &memory = shape_memory_[id];
+    memory_.triangulation_bytes += triangulation - memory.triangulation;
+    memory_.presentation_bytes += presentation - memory.presentation;
+    memory.triangulation = triangulation;
+    memory.presentation = presentation;
+    memory_.triangulation_peak_bytes =
+        std::max(memory_.triangulation_peak_bytes, memory_.triangulation_bytes);
+    memory_.presentation_peak_bytes =
+        std::max(memory_.presentation_peak_bytes, memory_.presentation_bytes);
+}
+
+void OccSceneManager::untrackShape(const std::string &id)
+{
+    auto it = shape_memory_.find(id);
+    if (it == shape_memory_.end())
+    {
+        return;
+    }
+    memory_.triangulation_bytes -= it->second.triangulation;
+    memory_.presentation_bytes -= it->second.presentation;
+    if (it->second.hidden)
+    {
+        hidden_lru_.erase(it->second.lru);
+    }
+    shape_memory_.erase(it);
+}
+
+void OccSceneManager::enforceMemoryBudget()
+{
+    if (memory_.budget_bytes == 0 || context_.IsNull())
+    {
+        return;
+    }
+    const size_t before = hidden_lru_.size();
+    while (!hidden_lru_.empty() &&
+           memory_.triangulation_bytes + memory_.presentation_bytes > memory_.budget_bytes)
+    {
+        evictShape(hidden_lru_.front());
+    }
+    if (hidden_lru_.size() != before)
+    {
+        qCDebug(lcOccScene) << "Evicted" << before - hidden_lru_.size()
+                            << "hidden shapes, scene memory"
+                            << memory_.triangulation_bytes + memory_.presentation_bytes
+                            << "bytes";
+    }
+}
+
+void OccSceneManager::evictShape(const std::string &id)
+{
+    auto it = shapes_.find(id);
+    if (it == shapes_.end())
+    {
+        untrackShape(id);
+        return;
+    }
+
+    Handle(AIS_Shape) aisShape = it->second;
+    Dormant &dormant = dormant_[id];
+    dormant.shape = sourceShape(aisShape);
+    aisShape->Color(dormant.color);
+
+    // presentations, selection, the coarser levels and the triangulated
+    // copy go with the AIS object, the caller's shape is never written.
+    // Showing the shape again remeshes it or reads the cache.
+    untrackShape(id);
+    touchObject(id);
+    context_->Remove(aisShape, false);
+    selection_pending_.erase(id);
+    shapes_.erase(it);
+    ++memory_.evictions;
+}
+
+size_t OccSceneManager::setGroupVisible(const std::string &path, bool visible)
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::setGroupVisible");
+    std::vector<std::string> ids;
+    collectGroup(path, ids);
+    size_t count = 0;
+    beginUpdate();
+    for (const std::string &id : ids)
+    {
+        if (setShapeVisible(id, visible))
+        {
+            ++count;
+        }
+    }
+    endUpdate();
+    return count;
+}
+
+size_t OccSceneManager::setGroupColor(const std::string &path, const Quantity_Color &color)
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::setGroupColor");
+    std::vector<std::string> ids;
+    collectGroup(path, ids);
+    size_t count = 0;
+    beginUpdate();
+    for (const std::string &id : ids)
+    {
+        if (setShapeColor(id, color))
+        {
+            ++count;
+        }
+    }
+    view_dirty_ = view_dirty_ || count > 0;
+    endUpdate();
+    return count;
+}
+
+int OccSceneManager::updateCulling()
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::updateCulling");
+    if (context_.IsNull() || view_.IsNull() || view_->Window().IsNull() ||
+        groups_.count(std::string()) == 0)
+    {
+        return 0;
+    }
+
+    const Handle(Graphic3d_Camera) &camera = view_->Camera();
+    int width = 0;
+    int height = 0;
+    view_->Window()->Size(width, height);
+    const Graphic3d_Vec2i viewSize(width, height);
+    if (!culling_dirty_ && viewSize == culling_view_size_ &&
+        camera->WorldViewProjState() == culling_camera_state_)
+    {
+        return 0;
+    }
+    culling_dirty_ = false;
+    culling_view_size_ = viewSize;
+    culling_camera_state_ = camera->WorldViewProjState();
+    if (width <= 0 || height <= 0)
+    {
+        return 0;
+    }
+
+    refreshGroupBox(std::string());
+    culling_stats_.drawn = 0;
+    int changes = 0;
+    cullGroup(std::string(), false, camera, changes);
+    culling_stats_.culled = culled_.size();
+    culling_stats_.groups = groups_.size();
+    if (changes > 0)
+    {
+        // objects coming back into view need their level of detail
+        lod_dirty_ = true;
+    }
+    return changes;
+}
+
+void OccSceneManager::linkToGroup(const std::string &id)
+{
+    // create the missing groups up to the root
+    std::string child = id;
+    std::string path = parentPath(id);
+    bool member = true;
+    for (;;)
+    {
+        auto it = groups_.find(path);
+        const bool created = it == groups_.end();
+        SceneGroup &group = created ? groups_[path] : it->second;
+        if (member)
+        {
+            group.members[id] = Bnd_Box();
+            member = false;
+        }
+        else
+        {
+            group.children.insert(child);
+        }
+        if (!created || path.empty())
+        {
+            break;
+        }
+        child = path;
+        path = parentPath(path);
+    }
+    touchObject(id);
+}
+
+void OccSceneManager::unlinkFromGroup(const std::string &id)
+{
+    culled_.erase(id);
+    std::string path = parentPath(id);
+    auto it = groups_.find(path);
+    if (it == groups_.end())
+    {
+        return;
+    }
+    it->second.members.erase(id);
+    markGroupDirty(path);
+
+    // drop the groups left empty, the root stays
+    while (!path.empty())
+    {
+        it = groups_.find(path);
+        if (it == groups_.end() || !it->second.members.empty() ||
+            !it->second.children.empty())
+        {
+            break;
+        }
+        groups_.erase(it);
+        const std::string parent = parentPath(path);
+        groups_[parent].children.erase(path);
+        path = parent;
+    }
+}
+
+void OccSceneManager::touchObject(const std::string &id)
+{
+    culled_.erase(id);
+    markGroupDirty(parentPath(id));
+}
+
+void OccSceneManager::markGroupDirty(const std::string &path)
+{
+    culling_dirty_ = true;
+    std::string current = path;
+    for (;;)
+    {
+        auto it = groups_.find(current);
+        // groups above a dirty one are dirty and not culled already
+        if (it == groups_.end() || it->second.box_dirty)
+        {
+            return;
+        }
+        it->second.box_dirty = true;
+        it->second.culled = false;
+        if (current.empty())
+        {
+            return;
+        }
+        current = parentPath(current);
+    }
+}
+
+void OccSceneManager::refreshGroupBox(const std::string &path)
+{
+    SceneGroup &group = groups_.at(path);
+    if (!group.box_dirty)
+    {
+        return;
+    }
+    group.box.SetVoid();
+    for (auto &member : group.members)
+    {
+        member.second.SetVoid();
+        Handle(AIS_InteractiveObject) object = getObject(member.first);
+        if (!object.IsNull())
+        {
+            object->BoundingBox(member.second);
+        }
+        group.box.Add(member.second);
+    }
+    for (const std::string &child : group.children)
+    {
+        refreshGroupBox(child);
+        group.box.Add(groups_.at(child).box);
+    }
+    group.box_dirty = false;
+}
+
+void OccSceneManager::cullGroup(const std::string &path, bool culled,
+                                const Handle(Graphic3d_Camera) & camera, int &changes)
+{
+    SceneGroup &group = groups_.at(path);
+    culled = culled || isOutside(camera, group.box);
+    if (culled && group.culled)
+    {
+        // everything below is culled already
+        return;
+    }
+    group.culled = culled;
+
+    for (const auto &member : group.members)
+    {
+        if (setCulled(member.first, culled || isOutside(camera, member.second)))
+        {
+            ++changes;
+        }
+    }
+    for (const std::string &child : group.children)
+    {
+        cullGroup(child, culled, camera, changes);
+    }
+}
+
+bool OccSceneManager::setCulled(const std::string &id, bool culled)
+{
+    Handle(AIS_InteractiveObject) object = getObject(id);
+    if (object.IsNull() || !context_->IsDisplayed(object))
+    {
+        // hidden or not built, tested again once displayed
+        culled_.erase(id);
+        return false;
+    }
+
+    if (!culled)
+    {
+        ++culling_stats_.drawn;
+    }
+    const bool wasCulled = culled_.count(id) > 0;
+    if (culled == wasCulled)
+    {
+        return false;
+    }
+    if (culled)
+    {
+        culled_.insert(id);
+    }
+    else
+    {
+        culled_.erase(id);
+    }
+    return true;
+}
+
+void OccSceneManager::collectGroup(const std::string &path,
+                                   std::vector<std::string> &ids) const
+{
+    if (!path.empty())
+    {
+        // an object with the id of the group itself
+        auto parentIt = groups_.find(parentPath(path));
+        if (parentIt != groups_.end() && parentIt->second.members.count(path) > 0)
+        {
+            ids.push_back(path);
+        }
+    }
+    auto it = groups_.find(path);
+    if (it == groups_.end())
+    {
+        return;
+    }
+    for (const auto &member : it->second.members)
+    {
+        ids.push_back(member.first);
+    }
+    for (const std::string &child : it->second.children)
+    {
+        collectGroup(child, ids);
+    }
+}
+
+void OccSceneManager::addAssembly(const OccXdeAssembly &assembly)
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::addAssembly");
+    beginUpdate();
+    for (const OccXdePrototype &part : assembly.prototypes)
+    {
+        if (prototypes_.count(part.key) > 0)
+        {
+            continue;
+        }
+        Prototype &prototype = prototypes_[part.key];
+        prototype.color = part.color;
+
+        OccMeshJob job;
+        job.id = part.key;
+        job.generation = next_generation_++;
+        job.shape = part.shape;
+        job.color = part.color;
+        job.display = false;
+        job.prototype = true;
+        prototype_pending_[part.key] = job.generation;
+        mesh_pipeline_->submit(std::move(job));
+    }
+
+    for (const OccXdeInstance &source : assembly.instances)
+    {
+        auto prototypeIt = prototypes_.find(source.prototype);
+        if (prototypeIt == prototypes_.end())
+        {
+            continue;
+        }
+        removeShape(source.id);
+
+        Instance &instance = instances_[source.id];
+        instance.prototype = source.prototype;
+        instance.location = source.location;
+        instance.color = source.color;
+        prototypeIt->second.users.insert(source.id);
+        linkToGroup(source.id);
+        if (!prototypeIt->second.ais.IsNull())
+        {
+            showInstance(source.id);
+        }
+    }
+    qCDebug(lcOccScene) << "Assembly:" << assembly.instances.size() << "instances of"
+                        << assembly.prototypes.size() << "parts";
+    endUpdate();
+}
+
+bool OccSceneManager::isInstance(const std::string &id) const
+{
+    return instances_.count(id) > 0;
+}
+
+void OccSceneManager::commitPrototype(OccMeshResult &result)
+{
+    auto pendingIt = prototype_pending_.find(result.id);
+    if (pendingIt == prototype_pending_.end() || pendingIt->second != result.generation)
+    {
+        // all instances removed while meshing
+        return;
+    }
+    prototype_pending_.erase(pendingIt);
+
+    auto it = prototypes_.find(result.id);
+    if (it == prototypes_.end())
+    {
+        return;
+    }
+    it->second.ais = Handle(OccLodShape)::DownCast(result.ais_shape);
+    requestSelection(result.id, it->second.ais, true);
+
+    for (const std::string &user : it->second.users)
+    {
+        showInstance(user);
+    }
+    batch_added_ += it->second.users.size();
+    view_dirty_ = true;
+}
+
+void OccSceneManager::applyInstanceColor(Instance &instance)
+{
+    // the part's presentation is shared as long as the color matches
+    if (prototypes_.at(instance.prototype).color.IsEqual(instance.color))
+    {
+        instance.object->UnsetColor();
+    }
+    else
+    {
+        instance.object->SetColor(instance.color);
+    }
+}
+
+void OccSceneManager::showInstance(const std::string &id)
+{
+    Instance &instance = instances_.at(id);
+    const Prototype &prototype = prototypes_.at(instance.prototype);
+    instance.object = new OccLodInstance();
+    instance.object->Connect(prototype.ais, instance.location.Transformation());
+    instance.object->SetDisplayMode(AIS_Shaded);
+    applyInstanceColor(instance);
+    context_->Display(instance.object, AIS_Shaded, prototype.selectable ? 0 : -1, false);
+    touchObject(id);
+    view_dirty_ = true;
+}
+
+void OccSceneManager::removeInstance(const std::string &id)
+{
+    auto it = instances_.find(id);
+    if (it == instances_.end())
+    {
+        return;
+    }
+    if (!it->second.object.IsNull())
+    {
+        context_->Remove(it->second.object, false);
+        view_dirty_ = true;
+    }
+    const std::string key = it->second.prototype;
+    unlinkFromGroup(id);
+    instances_.erase(it);
+    releasePrototype(key, id);
+    ++batch_removed_;
+}
+
+void OccSceneManager::releasePrototype(const std::string &key, const std::string &user)
+{
+    auto it = prototypes_.find(key);
+    if (it == prototypes_.end())
+    {
+        return;
+    }
+    it->second.users.erase(user);
+    if (it->second.users.empty())
+    {
+        // memory follows the parts in use, pending work for it is dropped
+        prototype_pending_.erase(key);
+        prototype_selection_pending_.erase(key);
+        prototypes_.erase(it);
+    }
+}
+
+bool OccSceneManager::addMesh(const std::string &id,
+                              const Handle(Poly_Triangulation) & triangulation,
+                              const Handle(TColStd_HArray1OfInteger) & colors,
+                              const Quantity_Color &color, bool display)
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::addMesh");
+    if (context_.IsNull() || triangulation.IsNull())
+    {
+        return false;
+    }
+
+    beginUpdate();
+    removeShape(id);
+    Handle(AIS_Triangulation) mesh = new AIS_Triangulation(triangulation);
+    mesh->SetColor(color);
+    if (!colors.IsNull())
+    {
+        mesh->SetColors(colors);
+    }
+    meshes_[id] = mesh;
+    // counted in the budget, but never evicted: there is no BRep to rebuild from
+    trackMesh(id, mesh);
+    if (display)
+    {
+        context_->Display(mesh, 0, -1, false);
+    }
+    linkToGroup(id);
+    ++batch_added_;
+    view_dirty_ = true;
+    endUpdate();
+    return true;
+}
+
+bool OccSceneManager::updateMeshVertices(const std::string &id, const QByteArray &data)
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::updateMeshVertices");
+    auto it = meshes_.find(id);
+    if (it == meshes_.end())
+    {
+        Q_EMIT shapeFailed(QString::fromStdString(id), QStringLiteral("not a mesh"));
+        return false;
+    }
+
+    const Handle(AIS_Triangulation) &mesh = it->second;
+    Handle(TColStd_HArray1OfInteger) colors = mesh->GetColors();
+    std::string error;
+    if (!OccBinaryMesh::readVertices(data, mesh->GetTriangulation(), colors, &error))
+    {
+        qCWarning(lcOccScene) << "Mesh update failed for" << id.c_str() << error.c_str();
+        Q_EMIT shapeFailed(QString::fromStdString(id), QString::fromStdString(error));
+        return false;
+    }
+    if (!colors.IsNull())
+    {
+        mesh->SetColors(colors);
+    }
+    // the triangles are kept, only the vertex buffers are refilled
+    context_->Redisplay(mesh, false);
+    touchObject(id);
+    view_dirty_ = true;
+    return true;
+}
+
+size_t OccSceneManager::addMeshFile(const std::shared_ptr<OccMeshFile> &file)
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::addMeshFile");
+    size_t count = 0;
+    beginUpdate();
+    for (const OccMeshFile::Object &object : file->objects())
+    {
+        if (addMesh(object.id, object.triangulation, Handle(TColStd_HArray1OfInteger)(),
+                    object.color, true))
+        {
+            mesh_files_[object.id] = file;
+            ++count;
+        }
+    }
+    endUpdate();
+    return count;
+}
+
+void OccSceneManager::saveMeshFile(const std::string &path,
+                                   std::function<void(bool ok, const std::string &error)> done)
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::saveMeshFile");
+    auto scene = std::make_shared<std::vector<OccMeshFile::SceneObject>>(
+        OccMeshFile::collectScene(*this));
+    mesh_pipeline_->start([scene, path, done = std::move(done)]() {
+        std::string error;
+        const bool ok = OccMeshFile::writeScene(*scene, path, &error);
+        done(ok, error);
+    });
+}
+
+bool OccSceneManager::removeMesh(const std::string &id)
+{
+    auto it = meshes_.find(id);
+    if (it == meshes_.end())
+    {
+        return false;
+    }
+    context_->Remove(it->second, false);
+    untrackShape(id);
+    unlinkFromGroup(id);
+    meshes_.erase(it);
+    // unmapped with the last mesh of the file
+    mesh_files_.erase(id);
+    ++batch_removed_;
+    view_dirty_ = true;
+    return true;
+}
+
+void OccSceneManager::setLodPixelError(double pixels)
+{
+    if (pixels > 0.0 && pixels != lod_pixel_error_)
+    {
+        lod_pixel_error_ = pixels;
+        lod_dirty_ = true;
+    }
+}
+
+int OccSceneManager::updateLevelOfDetail()
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::updateLevelOfDetail");
+    if (context_.IsNull() || view_.IsNull() || view_->Window().IsNull())
+    {
+        return 0;
+    }
+
+    const Handle(Graphic3d_Camera) &camera = view_->Camera();
+    int width = 0;
+    int height = 0;
+    view_->Window()->Size(width, height);
+    const Graphic3d_Vec2i viewSize(width, height);
+    if (!lod_dirty_ && viewSize == lod_view_size_ &&
+        camera->WorldViewProjState() == lod_camera_state_)
+    {
+        return 0;
+    }
+    lod_dirty_ = false;
+    lod_view_size_ = viewSize;
+    lod_camera_state_ = camera->WorldViewProjState();
+    if (width <= 0 || height <= 0)
+    {
+        return 0;
+    }
+
+    // screen space error of a world distance at the given point, in pixels
+    const gp_Dir up = camera->Up();
+    auto projectedError = [&](const gp_Pnt &center, double distance) {
+        const gp_Pnt p0 = camera->Project(center);
+        const gp_Pnt p1 = camera->Project(center.Translated(gp_Vec(up) * distance));
+        const double dx = (p1.X() - p0.X()) * 0.5 * width;
+        const double dy = (p1.Y() - p0.Y()) * 0.5 * height;
+        return std::sqrt(dx * dx + dy * dy);
+    };
+
+    int switched = 0;
+    for (const auto &pair : shapes_)
+    {
+        Handle(OccLodShape) lodShape = Handle(OccLodShape)::DownCast(pair.second);
+        if (lodShape.IsNull() || lodShape->nbLevels() < 2 ||
+            !context_->IsDisplayed(lodShape) || culled_.count(pair.first) > 0)
+        {
+            continue;
+        }
+
+        const Bnd_Box &box = lodShape->BoundingBox();
+        if (box.IsVoid())
+        {
+            continue;
+        }
+        const gp_Pnt center((box.CornerMin().XYZ() + box.CornerMax().XYZ()) * 0.5);
+
+        // coarsest level within the target, the threshold is lowered when
+        // getting coarser to avoid flickering around the boundary
+        const int current = lodShape->activeLevel();
+        int level = 0;
+        for (int candidate = lodShape->nbLevels() - 1; candidate > 0; --candidate)
+        {
+            const double threshold =
+                candidate > current ? lod_pixel_error_ * 0.75 : lod_pixel_error_;
+            if (projectedError(center, lodShape->levelDeflection(candidate)) <= threshold)
+            {
+                level = candidate;
+                break;
+            }
+        }
+
+        if (level != current)
+        {
+            lodShape->setActiveLevel(level);
+            context_->SetDisplayMode(lodShape, OccLodShape::displayMode(level), false);
+            ++switched;
+        }
+    }
+    return switched;
+}
+
+Handle(AIS_Shape) OccSceneManager::getShape(const std::string &id) const
+{
+    auto it = shapes_.find(id);
+    if (it != shapes_.end())
+    {
+        return it->second;
+    }
+    auto instanceIt = instances_.find(id);
+    if (instanceIt != instances_.end())
+    {
+        auto prototypeIt = prototypes_.find(instanceIt->second.prototype);
+        if (prototypeIt != prototypes_.end())
+        {
+            return prototypeIt->second.ais;
+        }
+    }
+    return Handle(AIS_Shape)();
+}
+
+Handle(AIS_InteractiveObject) OccSceneManager::getObject(const std::string &id) const
+{
+    auto instanceIt = instances_.find(id);
+    if (instanceIt != instances_.end())
+    {
+        return instanceIt->second.object;
+    }
+    auto meshIt = meshes_.find(id);
+    if (meshIt != meshes_.end())
+    {
+        return meshIt->second;
+    }
+    return getShape(id);
+}
+
+std::vector<std::string> OccSceneManager::getAllShapeIds() const
+{
+    std::vector<std::string> ids;
+    ids.reserve(shapes_.size() + instances_.size() + meshes_.size() + dormant_.size());
+    for (const auto &pair : shapes_)
+    {
+        ids.push_back(pair.first);
+    }
+    for (const auto &pair : instances_)
+    {
+        ids.push_back(pair.first);
+    }
+    for (const auto &pair : meshes_)
+    {
+        ids.push_back(pair.first);
+    }
+    for (const auto &pair : dormant_)
+    {
+        // shown again and meshing, not yet in shapes_
+        ids.push_back(pair.first);
+    }
+    return ids;
+}
+
+void OccSceneManager::clearAllShapes()
+{
+    OCC_TRACE_SCOPE("scene", "OccSceneManager::clearAllShapes");
+    beginUpdate();
+    std::vector<std::string> pending;
+    for (const auto &pair : pending_)
+    {
+        pending.push_back(pair.first);
+    }
+    for (const std::string &id : pending)
+    {
+        cancelPending(id);
+    }
+    selection_pending_.clear();
+    prototype_pending_.clear();
+    prototype_selection_pending_.clear();
+    if (!context_.IsNull())
+    {
+        context_->RemoveAll(false);
+        // 强制更新视图
+        view_dirty_ = true;
+    }
+    batch_removed_ += shapes_.size() + instances_.size() + meshes_.size() + dormant_.size();
     shapes_.clear();
+    instances_.clear();
+    prototypes_.clear();
+    meshes_.clear();
+    mesh_files_.clear();
+    dormant_.clear();
+    groups_.clear();
+    culled_.clear();
+    culling_dirty_ = true;
+    shape_memory_.clear();
+    hidden_lru_.clear();
+    memory_.triangulation_bytes = 0;
+    memory_.presentation_bytes = 0;
+    endUpdate();
 }
 } // namespace geotoys
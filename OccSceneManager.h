@@ -1,26 +1,93 @@
 #ifndef OCCSCENEMANAGER_H
 #define OCCSCENEMANAGER_H
 
-#include <map>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include <QElapsedTimer>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QObject>
 #include <QWheelEvent>
 
 #include <AIS_AnimationCamera.hxx>
+#include <AIS_ConnectedInteractive.hxx>
 #include <AIS_InteractiveContext.hxx>
 #include <AIS_Shape.hxx>
+#include <AIS_Triangulation.hxx>
 #include <AIS_ViewCube.hxx>
+#include <Bnd_Box.hxx>
+#include <Graphic3d_Camera.hxx>
+#include <Graphic3d_Vec2.hxx>
+#include <Graphic3d_WorldViewProjState.hxx>
+#include <Poly_Triangulation.hxx>
 #include <Standard_Handle.hxx>
+#include <TColStd_HArray1OfInteger.hxx>
 #include <TopoDS_Shape.hxx>
 #include <V3d_View.hxx>
 
+#include "OccLodShape.h"
+#include "OccMeshFile.h"
+#include "OccMeshPipeline.h"
+#include "OccXdeImporter.h"
+
 namespace geotoys
 {
 
+struct OccShapeDesc
+{
+    std::string id;
+    TopoDS_Shape shape;
+    Quantity_Color color = Quantity_NOC_YELLOW;
+    bool display = true;
+};
+
+// Background selection: displayed shapes become pickable once their
+// sensitive entities are built on a worker thread
+struct OccSelectionStats
+{
+    size_t pending = 0;
+    uint64_t activated = 0;
+    // time from display to activation
+    double last_lag_ms = 0.0;
+    double mean_lag_ms = 0.0;
+    double max_lag_ms = 0.0;
+};
+
+// Estimated memory of the scene, see OccSceneManager::setMemoryBudget()
+struct OccMemoryStats
+{
+    // 0 means unlimited
+    uint64_t budget_bytes = 0;
+    // face triangulations of the BReps, all detail levels
+    uint64_t triangulation_bytes = 0;
+    uint64_t triangulation_peak_bytes = 0;
+    // vertex and index arrays of the computed presentations
+    uint64_t presentation_bytes = 0;
+    uint64_t presentation_peak_bytes = 0;
+    size_t visible_shapes = 0;
+    // erased, presentation kept
+    size_t hidden_shapes = 0;
+    // never displayed or evicted, BRep only
+    size_t dormant_shapes = 0;
+    uint64_t evictions = 0;
+};
+
+// Frustum culling of the scene groups, counts of the last update
+struct OccCullingStats
+{
+    size_t groups = 0;
+    // displayed objects inside and outside the view volume
+    size_t drawn = 0;
+    size_t culled = 0;
+};
+
 class OccSceneManager : public QObject
 {
     Q_OBJECT
@@ -37,21 +104,283 @@ public:
     bool addShape(const std::string &id, const TopoDS_Shape &shape,
                   const Quantity_Color &color, bool display);
     bool removeShape(const std::string &id);
+    // The new shape is meshed in background like addShapeAsync(), the old
+    // one stays displayed until then and shapeReady() is emitted
     bool updateShape(const std::string &id, const TopoDS_Shape &shape);
     bool setShapeColor(const std::string &id, const Quantity_Color &color);
 
+    // Batch variants, run as a single update transaction
+    size_t addShapes(const std::vector<OccShapeDesc> &shapes);
+    size_t removeShapes(const std::vector<std::string> &ids);
+
+    // Update transaction: view invalidation, the memory budget and logging
+    // are deferred until the outermost endUpdate(). Calls nest.
+    void beginUpdate();
+    void endUpdate();
+
+    // Background tessellation: the shape is meshed on a worker thread and
+    // displayed by commitFinishedShapes() once ready, shapeReady() is emitted
+    // at that moment.
+    void addShapeAsync(const std::string &id, const TopoDS_Shape &shape,
+                       const Quantity_Color &color, bool display);
+    void addShapesAsync(const std::vector<OccShapeDesc> &shapes);
+    bool isShapeReady(const std::string &id) const;
+    bool hasPendingShapes() const;
+    void setMeshParameters(const OccMeshParameters &params);
+
+    // Persistent triangulation cache used by addShape() and addShapeAsync(),
+    // nullptr disables it
+    void setMeshCache(std::shared_ptr<OccMeshCache> cache);
+    OccMeshCacheStats meshCacheStats() const;
+
+    // Display finished shapes, must be called from the render thread. Stops
+    // when the time budget is exceeded so that the frame time stays flat.
+    // Returns true when some results are still waiting for the next frame.
+    bool commitFinishedShapes(double budget_ms);
+
+    // Instanced assemblies: each prototype is meshed once in background and
+    // its instances are AIS_ConnectedInteractive objects sharing the
+    // prototype presentation. Instance ids work with getShape() (returns the
+    // shared prototype), setShapeColor() and removeShape(). A recolored
+    // instance draws the triangle arrays of its part with its own aspect,
+    // see OccLodInstance.
+    void addAssembly(const OccXdeAssembly &assembly);
+    bool isInstance(const std::string &id) const;
+    size_t prototypeCount() const
+    {
+        return prototypes_.size();
+    }
+
+    // Meshes without BRep (simulation results), displayed as
+    // AIS_Triangulation straight from the triangulation without meshing.
+    // colors are optional per vertex colors. Not selectable, no level of
+    // detail. updateMeshVertices() rewrites the vertex data of the existing
+    // triangulation in place, see OccBinaryMesh for the layout.
+    bool addMesh(const std::string &id, const Handle(Poly_Triangulation) & triangulation,
+                 const Handle(TColStd_HArray1OfInteger) & colors,
+                 const Quantity_Color &color, bool display);
+    bool updateMeshVertices(const std::string &id, const QByteArray &data);
+    bool isMesh(const std::string &id) const
+    {
+        return meshes_.count(id) > 0;
+    }
+    // Adds every object of a mapped mesh file, the triangulations keep
+    // aliasing the mapping which stays open while any of them is shown
+    size_t addMeshFile(const std::shared_ptr<OccMeshFile> &file);
+    // Writes the displayed triangulations with OccMeshFile. Only handles are
+    // taken here, merging and writing run on the mesh pool, which also
+    // calls done.
+    void saveMeshFile(const std::string &path,
+                      std::function<void(bool ok, const std::string &error)> done);
+
+    // Shapes are displayed without selection, the selection structures are
+    // built in background and activated by commitFinishedShapes(). Until
+    // then the shape is not highlighted on hover.
+    OccSelectionStats selectionStats() const;
+
+    // Level of detail: pick per displayed shape the coarsest triangulation
+    // whose deflection projects below the pixel error target. Must be called
+    // from the render thread before redraw, returns the number of switches.
+    void setLodPixelError(double pixels);
+    int updateLevelOfDetail();
+
+    // Visibility without removal. A hidden shape keeps its presentation and
+    // triangulation until the memory budget is exceeded, then the least
+    // recently hidden shapes are evicted down to their BRep. Showing an
+    // evicted shape, or one added with display = false which is not built
+    // before, meshes it in background, from the mesh cache when set.
+    // Meshes count towards the budget but are never evicted, instances
+    // share the triangulation of their part and are not counted. A shape
+    // still meshing takes the visibility when committed.
+    bool setShapeVisible(const std::string &id, bool visible);
+    bool isShapeVisible(const std::string &id) const;
+    void setMemoryBudget(uint64_t bytes);
+    OccMemoryStats memoryStats() const;
+
+    // Scene groups follow the '/' separated ids: "plant/unit1/pump" is a
+    // member of group "plant/unit1", a child of "plant", a child of the root
+    // group "". Groups cache the combined bounding box of their members and
+    // children. The group operations apply to path itself and everything
+    // below it, "" is the whole scene.
+    size_t setGroupVisible(const std::string &path, bool visible);
+    size_t setGroupColor(const std::string &path, const Quantity_Color &color);
+
+    // Frustum test of the scene groups: objects whose box is outside the
+    // view are skipped by the level of detail update, a group outside as a
+    // whole is not looked into until the camera brings it back. Drawing is
+    // left to the frustum culling of OCCT, which works on its own BVH and
+    // keeps selection unaffected. Must be called from the render thread
+    // before redraw, returns the number of objects changing state.
+    int updateCulling();
+    OccCullingStats cullingStats() const
+    {
+        return culling_stats_;
+    }
+
     // Get geometry object
     Handle(AIS_Shape) getShape(const std::string &id) const;
+    // The displayed object, AIS_ConnectedInteractive for instances
+    Handle(AIS_InteractiveObject) getObject(const std::string &id) const;
     std::vector<std::string> getAllShapeIds() const;
 
     // Clear scene
     void clearAllShapes();
 
+Q_SIGNALS:
+    void shapeReady(const QString &id);
+    // Background meshing of a pending shape threw, the shape is not added,
+    // or updateMeshVertices() could not read the vertices
+    void shapeFailed(const QString &id, const QString &error);
+    // A pending shape was removed, replaced or hidden before it was shown,
+    // neither shapeReady() nor shapeFailed() follows for it
+    void shapeCancelled(const QString &id);
+    // Emitted from a worker thread, request a new frame to commit results
+    void meshFinished();
+
+private:
+    void submitShape(const std::string &id, const TopoDS_Shape &shape,
+                     const Quantity_Color &color);
+    // false when the updated shape is no longer displayed by an OccLodShape
+    bool commitUpdate(const OccMeshResult &result);
+    void commitFailure(const OccMeshResult &result);
+    // drop the background result of id, true when there was one
+    bool cancelPending(const std::string &id);
+    void displayShape(const std::string &id, const Handle(AIS_Shape) & aisShape);
+    // reuse: entities of the previous selection, see OccSelectionJob
+    void requestSelection(const std::string &id, const Handle(AIS_Shape) & aisShape,
+                          bool prototype = false,
+                          std::vector<Handle(Select3D_SensitiveEntity)> reuse = {});
+    void activateSelection(OccSelectionResult &result);
+    void activatePrototypeSelection(OccSelectionResult &result, double lagMs);
+    void recordSelectionLag(double lagMs);
+
+    // assembly instancing
+    void commitPrototype(OccMeshResult &result);
+    struct Instance;
+    // own color of the instance object when it differs from its part
+    void applyInstanceColor(Instance &instance);
+    void showInstance(const std::string &id);
+    void removeInstance(const std::string &id);
+    void releasePrototype(const std::string &key, const std::string &user);
+    bool removeMesh(const std::string &id);
+
+    // memory budget
+    void trackShape(const std::string &id, const Handle(AIS_Shape) & aisShape);
+    void trackMesh(const std::string &id, const Handle(AIS_Triangulation) & mesh);
+    void recordMemory(const std::string &id, uint64_t triangulation, uint64_t presentation);
+    void untrackShape(const std::string &id);
+    void enforceMemoryBudget();
+    void evictShape(const std::string &id);
+
+    // scene groups
+    void linkToGroup(const std::string &id);
+    void unlinkFromGroup(const std::string &id);
+    // the object of id was replaced, shown or changed its geometry
+    void touchObject(const std::string &id);
+    void markGroupDirty(const std::string &path);
+    void refreshGroupBox(const std::string &path);
+    void cullGroup(const std::string &path, bool culled,
+                   const Handle(Graphic3d_Camera) & camera, int &changes);
+    bool setCulled(const std::string &id, bool culled);
+    void collectGroup(const std::string &path, std::vector<std::string> &ids) const;
+
 private:
     Handle(AIS_InteractiveContext) context_;
     Handle(V3d_View) view_;
 
-    std::map<std::string, Handle(AIS_Shape)> shapes_;
+    std::unordered_map<std::string, Handle(AIS_Shape)> shapes_;
+    // id -> generation of the latest async request, older results are dropped
+    std::unordered_map<std::string, uint64_t> pending_;
+    // setShapeVisible() on an id still meshing, applied on commit
+    std::unordered_map<std::string, bool> pending_visible_;
+    uint64_t next_generation_ = 1;
+    std::unique_ptr<OccMeshPipeline> mesh_pipeline_;
+
+    // background selection state, id -> generation and display time
+    struct SelectionRequest
+    {
+        uint64_t generation = 0;
+        double displayed_ms = 0.0;
+    };
+    std::unordered_map<std::string, SelectionRequest> selection_pending_;
+    std::unordered_map<std::string, SelectionRequest> prototype_selection_pending_;
+    OccSelectionStats selection_stats_;
+    QElapsedTimer clock_;
+
+    struct Prototype
+    {
+        // null while meshed in background
+        Handle(OccLodShape) ais;
+        Quantity_Color color;
+        bool selectable = false;
+        // instance ids
+        std::unordered_set<std::string> users;
+    };
+    struct Instance
+    {
+        std::string prototype;
+        TopLoc_Location location;
+        Quantity_Color color;
+        // null until the prototype is meshed
+        Handle(OccLodInstance) object;
+    };
+    std::unordered_map<std::string, Prototype> prototypes_;
+    std::unordered_map<std::string, Instance> instances_;
+    std::unordered_map<std::string, Handle(AIS_Triangulation)> meshes_;
+    // mapped files backing meshes loaded by addMeshFile()
+    std::unordered_map<std::string, std::shared_ptr<OccMeshFile>> mesh_files_;
+    // shapes without AIS object, built when shown
+    struct Dormant
+    {
+        TopoDS_Shape shape;
+        Quantity_Color color;
+        // meshed in background for display, pending_ holds the generation
+        bool requested = false;
+    };
+    std::unordered_map<std::string, Dormant> dormant_;
+    // estimated bytes of the built shapes, hidden ones in eviction order
+    struct ShapeMemory
+    {
+        uint64_t triangulation = 0;
+        uint64_t presentation = 0;
+        bool hidden = false;
+        std::list<std::string>::iterator lru;
+    };
+    std::unordered_map<std::string, ShapeMemory> shape_memory_;
+    std::list<std::string> hidden_lru_;
+    OccMemoryStats memory_;
+    struct SceneGroup
+    {
+        std::unordered_set<std::string> children;
+        // member id -> bounding box, void while not built
+        std::unordered_map<std::string, Bnd_Box> members;
+        Bnd_Box box;
+        // set with the groups above by markGroupDirty()
+        bool box_dirty = false;
+        // culled as a whole by the last update and unchanged since
+        bool culled = false;
+    };
+    std::unordered_map<std::string, SceneGroup> groups_;
+    // displayed ids outside the view volume
+    std::unordered_set<std::string> culled_;
+    bool culling_dirty_ = true;
+    Graphic3d_Vec2i culling_view_size_;
+    Graphic3d_WorldViewProjState culling_camera_state_;
+    OccCullingStats culling_stats_;
+    // prototype key -> generation of the mesh job
+    std::unordered_map<std::string, uint64_t> prototype_pending_;
+
+    // state of the current update transaction
+    int update_depth_ = 0;
+    bool view_dirty_ = false;
+    size_t batch_added_ = 0;
+    size_t batch_removed_ = 0;
+
+    // level of detail selection state
+    double lod_pixel_error_ = 1.0;
+    bool lod_dirty_ = true;
+    Graphic3d_Vec2i lod_view_size_;
+    Graphic3d_WorldViewProjState lod_camera_state_;
     bool viewcube_visible_ = true;
     double device_pixel_ratio_ = 1.0;
 };
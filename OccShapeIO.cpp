@@ -0,0 +1,231 @@
+#include "OccShapeIO.h"
+
+#include <algorithm>
+#include <cctype>
+#include <utility>
+#include <vector>
+
+#include <BRepTools.hxx>
+#include <BRep_Builder.hxx>
+#include <IFSelect_ReturnStatus.hxx>
+#include <IGESControl_Reader.hxx>
+#include <Interface_EntityIterator.hxx>
+#include <Interface_Graph.hxx>
+#include <Message_ProgressScope.hxx>
+#include <STEPControl_Reader.hxx>
+#include <StepBasic_ProductDefinition.hxx>
+#include <StepRepr_NextAssemblyUsageOccurrence.hxx>
+#include <XSControl_WorkSession.hxx>
+
+namespace geotoys
+{
+
+IMPLEMENT_STANDARD_RTTIEXT(OccReadProgress, Message_ProgressIndicator)
+
+namespace
+{
+enum class ShapeFormat
+{
+    Unknown,
+    BRep,
+    Step,
+    Iges
+};
+
+ShapeFormat formatFromPath(const std::string &path)
+{
+    const size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+    {
+        return ShapeFormat::Unknown;
+    }
+
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return char(std::tolower(c)); });
+    if (ext == "brep" || ext == "brp")
+    {
+        return ShapeFormat::BRep;
+    }
+    if (ext == "step" || ext == "stp")
+    {
+        return ShapeFormat::Step;
+    }
+    if (ext == "iges" || ext == "igs")
+    {
+        return ShapeFormat::Iges;
+    }
+    return ShapeFormat::Unknown;
+}
+
+void setError(std::string *error, const std::string &message)
+{
+    if (error)
+    {
+        *error = message;
+    }
+}
+
+// Pieces translated one at a time: the first level occurrences of an
+// assembly root, each placed in the root frame, or the root itself
+std::vector<Handle(Standard_Transient)> transferUnits(STEPControl_Reader &reader, int root)
+{
+    const Handle(Standard_Transient) &entity = reader.RootForTransfer(root);
+    Handle(StepBasic_ProductDefinition) product =
+        Handle(StepBasic_ProductDefinition)::DownCast(entity);
+    std::vector<Handle(Standard_Transient)> units;
+    if (!product.IsNull())
+    {
+        const Interface_Graph &graph = reader.WS()->Graph();
+        for (Interface_EntityIterator it = graph.Sharings(product); it.More(); it.Next())
+        {
+            Handle(StepRepr_NextAssemblyUsageOccurrence) occurrence =
+                Handle(StepRepr_NextAssemblyUsageOccurrence)::DownCast(it.Value());
+            if (!occurrence.IsNull() && occurrence->RelatingProductDefinition() == product)
+            {
+                units.push_back(occurrence);
+            }
+        }
+    }
+    if (units.empty())
+    {
+        units.push_back(entity);
+    }
+    return units;
+}
+} // namespace
+
+bool OccShapeIO::isSupported(const std::string &path)
+{
+    return formatFromPath(path) != ShapeFormat::Unknown;
+}
+
+TopoDS_Shape OccShapeIO::readFile(const std::string &path, std::string *error)
+{
+    switch (formatFromPath(path))
+    {
+    case ShapeFormat::BRep:
+    {
+        TopoDS_Shape shape;
+        BRep_Builder builder;
+        if (!BRepTools::Read(shape, path.c_str(), builder))
+        {
+            setError(error, "cannot read BRep file " + path);
+            return TopoDS_Shape();
+        }
+        return shape;
+    }
+    case ShapeFormat::Step:
+    {
+        STEPControl_Reader reader;
+        if (reader.ReadFile(path.c_str()) != IFSelect_RetDone)
+        {
+            setError(error, "cannot read STEP file " + path);
+            return TopoDS_Shape();
+        }
+        reader.TransferRoots();
+        TopoDS_Shape shape = reader.OneShape();
+        if (shape.IsNull())
+        {
+            setError(error, "STEP file has no shapes " + path);
+        }
+        return shape;
+    }
+    case ShapeFormat::Iges:
+    {
+        IGESControl_Reader reader;
+        if (reader.ReadFile(path.c_str()) != IFSelect_RetDone)
+        {
+            setError(error, "cannot read IGES file " + path);
+            return TopoDS_Shape();
+        }
+        reader.TransferRoots();
+        TopoDS_Shape shape = reader.OneShape();
+        if (shape.IsNull())
+        {
+            setError(error, "IGES file has no shapes " + path);
+        }
+        return shape;
+    }
+    case ShapeFormat::Unknown: break;
+    }
+
+    setError(error, "unsupported file format " + path);
+    return TopoDS_Shape();
+}
+
+bool OccShapeIO::readStepRoots(
+    const std::string &path,
+    const std::function<void(int root, const TopoDS_Shape &shape)> &onShape,
+    const Message_ProgressRange &progress, std::string *error)
+{
+    // parsing reports no progress, count it as a fixed share
+    Message_ProgressScope scope(progress, "STEP import", 10);
+    STEPControl_Reader reader;
+    if (reader.ReadFile(path.c_str()) != IFSelect_RetDone)
+    {
+        setError(error, "cannot read STEP file " + path);
+        return false;
+    }
+    scope.Next(2);
+
+    // a file with a single assembly root still streams by sub-assembly,
+    // parts shared between them are translated once
+    std::vector<std::pair<int, Handle(Standard_Transient)>> units;
+    const int nbRoots = reader.NbRootsForTransfer();
+    for (int root = 1; root <= nbRoots; ++root)
+    {
+        for (const Handle(Standard_Transient) &unit : transferUnits(reader, root))
+        {
+            units.emplace_back(root, unit);
+        }
+    }
+
+    Message_ProgressScope transferScope(scope.Next(8), "Transfer roots", int(units.size()));
+    for (size_t unit = 0; unit < units.size() && transferScope.More(); ++unit)
+    {
+        const int nbShapes = reader.NbShapes();
+        reader.TransferEntity(units[unit].second, transferScope.Next());
+        for (int index = nbShapes + 1; index <= reader.NbShapes(); ++index)
+        {
+            const TopoDS_Shape shape = reader.Shape(index);
+            if (!shape.IsNull())
+            {
+                onShape(units[unit].first, shape);
+            }
+        }
+    }
+
+    if (transferScope.UserBreak())
+    {
+        setError(error, "import cancelled " + path);
+        return false;
+    }
+    return true;
+}
+
+OccReadProgress::OccReadProgress(std::function<void(double)> onProgress,
+                                 std::shared_ptr<std::atomic_bool> cancel)
+    : on_progress_(std::move(onProgress))
+    , cancel_(std::move(cancel))
+{
+}
+
+Standard_Boolean OccReadProgress::UserBreak()
+{
+    return cancel_ && cancel_->load();
+}
+
+void OccReadProgress::Show(const Message_ProgressScope & /*theScope*/,
+                           const Standard_Boolean isForce)
+{
+    // called for every step, only whole percents are forwarded
+    const double position = GetPosition();
+    if (isForce || position - last_reported_ >= 0.01)
+    {
+        last_reported_ = position;
+        on_progress_(position);
+    }
+}
+
+} // namespace geotoys
@@ -0,0 +1,62 @@
+#ifndef OCCSHAPEIO_H
+#define OCCSHAPEIO_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <Message_ProgressIndicator.hxx>
+#include <Message_ProgressRange.hxx>
+#include <TopoDS_Shape.hxx>
+
+namespace geotoys
+{
+
+// Model file reading, the format is chosen by extension:
+// .brep/.brp, .step/.stp and .iges/.igs
+class OccShapeIO
+{
+public:
+    static bool isSupported(const std::string &path);
+
+    // Returns a null shape on failure, error receives the reason
+    static TopoDS_Shape readFile(const std::string &path,
+                                 std::string *error = nullptr);
+
+    // STEP roots are translated one at a time and handed to onShape as soon
+    // as each one is ready, so that display can start before the whole file
+    // is translated. Assembly roots are split into their first level
+    // occurrences, onShape then runs once per occurrence with the same root
+    // index. Deeper levels are not split. Returns false on errors and on
+    // user break.
+    static bool readStepRoots(
+        const std::string &path,
+        const std::function<void(int root, const TopoDS_Shape &shape)> &onShape,
+        const Message_ProgressRange &progress, std::string *error = nullptr);
+};
+
+//! Progress indicator for reads on worker threads, forwards the position
+//! to a callback and reports a user break once cancel is set.
+class OccReadProgress : public Message_ProgressIndicator
+{
+    DEFINE_STANDARD_RTTIEXT(OccReadProgress, Message_ProgressIndicator)
+public:
+    OccReadProgress(std::function<void(double)> onProgress,
+                    std::shared_ptr<std::atomic_bool> cancel);
+
+    Standard_Boolean UserBreak() override;
+
+protected:
+    void Show(const Message_ProgressScope &theScope,
+              const Standard_Boolean isForce) override;
+
+private:
+    std::function<void(double)> on_progress_;
+    std::shared_ptr<std::atomic_bool> cancel_;
+    double last_reported_ = -1.0;
+};
+
+} // namespace geotoys
+
+#endif // OCCSHAPEIO_H
@@ -0,0 +1,117 @@
+#include <cstdint>
+#include <cstring>
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <Poly_Triangulation.hxx>
+
+#include "OccMeshFile.h"
+
+using geotoys::OccMeshFile;
+
+namespace
+{
+// FileHeader is 32 bytes, ObjectRecord::triangle_offset sits at byte 40
+const qint64 FIRST_RECORD = 32;
+const qint64 TRIANGLE_OFFSET_FIELD = FIRST_RECORD + 40;
+
+// unit quad, two triangles
+Handle(Poly_Triangulation) makeQuad()
+{
+    Handle(Poly_Triangulation) quad = new Poly_Triangulation(4, 2, false);
+    quad->SetNode(1, gp_Pnt(0.0, 0.0, 0.0));
+    quad->SetNode(2, gp_Pnt(1.0, 0.0, 0.0));
+    quad->SetNode(3, gp_Pnt(1.0, 1.0, 0.0));
+    quad->SetNode(4, gp_Pnt(0.0, 1.0, 0.0));
+    quad->SetTriangle(1, Poly_Triangle(1, 2, 3));
+    quad->SetTriangle(2, Poly_Triangle(1, 3, 4));
+    quad->ComputeNormals();
+    return quad;
+}
+
+QString writeQuadFile(const QTemporaryDir &dir)
+{
+    OccMeshFile::Object object;
+    object.id = "quad";
+    object.triangulation = makeQuad();
+    const QString path = dir.filePath("quad.ocmf");
+    if (!OccMeshFile::write({object}, path.toStdString()))
+    {
+        return QString();
+    }
+    return path;
+}
+} // namespace
+
+class OccMeshFileTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void roundTrip();
+    void rejectsTriangleIndexOutOfRange();
+    void rejectsTruncatedFile();
+};
+
+void OccMeshFileTest::roundTrip()
+{
+    QTemporaryDir dir;
+    const QString path = writeQuadFile(dir);
+    QVERIFY(!path.isEmpty());
+
+    std::string error;
+    std::shared_ptr<OccMeshFile> file = OccMeshFile::open(path.toStdString(), &error);
+    QVERIFY2(file != nullptr, error.c_str());
+    QCOMPARE(file->objects().size(), size_t(1));
+    const OccMeshFile::Object &object = file->objects().front();
+    QCOMPARE(object.id, std::string("quad"));
+    QCOMPARE(object.triangulation->NbNodes(), 4);
+    QCOMPARE(object.triangulation->NbTriangles(), 2);
+    QVERIFY(object.triangulation->HasNormals());
+}
+
+void OccMeshFileTest::rejectsTriangleIndexOutOfRange()
+{
+    QTemporaryDir dir;
+    const QString path = writeQuadFile(dir);
+    QVERIFY(!path.isEmpty());
+
+    // point the last corner of the first triangle past the vertex block
+    QFile raw(path);
+    QVERIFY(raw.open(QIODevice::ReadWrite));
+    QByteArray data = raw.readAll();
+    uint64_t triangleOffset = 0;
+    std::memcpy(&triangleOffset, data.constData() + TRIANGLE_OFFSET_FIELD,
+                sizeof(triangleOffset));
+    QVERIFY(triangleOffset + 3 * sizeof(int32_t) <= uint64_t(data.size()));
+    const int32_t badIndex = 5;
+    std::memcpy(data.data() + triangleOffset + 2 * sizeof(int32_t), &badIndex,
+                sizeof(badIndex));
+    QVERIFY(raw.seek(0));
+    QCOMPARE(raw.write(data), qint64(data.size()));
+    raw.close();
+
+    std::string error;
+    QVERIFY(OccMeshFile::open(path.toStdString(), &error) == nullptr);
+    QVERIFY(!error.empty());
+}
+
+void OccMeshFileTest::rejectsTruncatedFile()
+{
+    QTemporaryDir dir;
+    const QString path = writeQuadFile(dir);
+    QVERIFY(!path.isEmpty());
+
+    QFile raw(path);
+    QVERIFY(raw.resize(raw.size() - 8));
+
+    std::string error;
+    QVERIFY(OccMeshFile::open(path.toStdString(), &error) == nullptr);
+    QVERIFY(!error.empty());
+}
+
+QTEST_GUILESS_MAIN(OccMeshFileTest)
+
+#include "OccMeshFileTest.moc"
@@ -0,0 +1,191 @@
+#include "OccTrace.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+#include "OccLog.h"
+
+namespace geotoys
+{
+
+namespace
+{
+// spans kept per thread, 32 bytes each
+const uint64_t BUFFER_CAPACITY = 16384;
+
+struct TraceEvent
+{
+    const char *category;
+    const char *name;
+    int64_t start_ns;
+    int64_t end_ns;
+};
+
+// Written only by its thread; count is published with release semantics
+struct ThreadBuffer
+{
+    int tid = 0;
+    QString thread_name;
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> count{0};
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    // never freed, spans of finished threads stay available
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+std::chrono::steady_clock::time_point clockOrigin()
+{
+    static const std::chrono::steady_clock::time_point origin =
+        std::chrono::steady_clock::now();
+    return origin;
+}
+
+thread_local ThreadBuffer *t_buffer = nullptr;
+
+QString currentThreadName()
+{
+    QThread *thread = QThread::currentThread();
+    if (QCoreApplication::instance() &&
+        thread == QCoreApplication::instance()->thread())
+    {
+        return QStringLiteral("main");
+    }
+    if (!thread->objectName().isEmpty())
+    {
+        return thread->objectName();
+    }
+    return QString::fromLatin1(thread->metaObject()->className());
+}
+
+ThreadBuffer *threadBuffer()
+{
+    if (!t_buffer)
+    {
+        auto buffer = std::make_unique<ThreadBuffer>();
+        buffer->events.resize(BUFFER_CAPACITY);
+        buffer->thread_name = currentThreadName();
+
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffer->tid = static_cast<int>(reg.buffers.size()) + 1;
+        t_buffer = buffer.get();
+        reg.buffers.push_back(std::move(buffer));
+    }
+    return t_buffer;
+}
+} // namespace
+
+std::atomic<bool> OccTrace::enabled_{false};
+
+void OccTrace::setEnabled(bool enabled)
+{
+    clockOrigin();
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void OccTrace::clear()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const std::unique_ptr<ThreadBuffer> &buffer : reg.buffers)
+    {
+        buffer->count.store(0, std::memory_order_release);
+    }
+}
+
+int64_t OccTrace::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - clockOrigin())
+        .count();
+}
+
+void OccTrace::record(const char *category, const char *name, int64_t start_ns,
+                      int64_t end_ns)
+{
+    ThreadBuffer *buffer = threadBuffer();
+    const uint64_t index = buffer->count.load(std::memory_order_relaxed);
+    buffer->events[index % BUFFER_CAPACITY] = {category, name, start_ns, end_ns};
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+bool OccTrace::writeChromeTrace(const std::string &path)
+{
+    QJsonArray events;
+    {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (const std::unique_ptr<ThreadBuffer> &buffer : reg.buffers)
+        {
+            QJsonObject meta;
+            meta["ph"] = "M";
+            meta["name"] = "thread_name";
+            meta["pid"] = 1;
+            meta["tid"] = buffer->tid;
+            meta["args"] = QJsonObject{{"name", buffer->thread_name}};
+            events.append(meta);
+
+            const uint64_t count = buffer->count.load(std::memory_order_acquire);
+            const uint64_t first = count > BUFFER_CAPACITY ? count - BUFFER_CAPACITY : 0;
+            for (uint64_t i = first; i < count; ++i)
+            {
+                const TraceEvent &event = buffer->events[i % BUFFER_CAPACITY];
+                QJsonObject span;
+                span["ph"] = "X";
+                span["cat"] = event.category;
+                span["name"] = event.name;
+                span["pid"] = 1;
+                span["tid"] = buffer->tid;
+                span["ts"] = double(event.start_ns) / 1.0e3;
+                span["dur"] = double(event.end_ns - event.start_ns) / 1.0e3;
+                events.append(span);
+            }
+        }
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+
+    QFile file(QString::fromStdString(path));
+    const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        file.write(json) != json.size())
+    {
+        qCWarning(lcOccRender) << "Cannot write trace file" << path.c_str();
+        return false;
+    }
+    qCInfo(lcOccRender) << "Trace written to" << path.c_str();
+    return true;
+}
+
+std::string OccTrace::initFromEnvironment()
+{
+    const QString path = qEnvironmentVariable("OCC_TRACE_FILE");
+    if (qEnvironmentVariableIntValue("OCC_TRACE") != 0 || !path.isEmpty())
+    {
+        setEnabled(true);
+    }
+    return path.toStdString();
+}
+
+} // namespace geotoys
@@ -0,0 +1,79 @@
+#ifndef OCCTRACE_H
+#define OCCTRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace geotoys
+{
+
+// Scoped trace spans for render, input, scene and mesh work. Each thread
+// records into its own fixed size ring buffer, the oldest spans are
+// overwritten. writeChromeTrace() dumps all buffers as Chrome trace JSON,
+// viewable in chrome://tracing or Perfetto.
+//
+// Tracing is off by default, a disabled span costs one relaxed atomic load.
+// OCC_TRACE=1 enables it at startup and OCC_TRACE_FILE=<path> additionally
+// writes the trace when the application exits.
+class OccTrace
+{
+public:
+    static bool isEnabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+    static void setEnabled(bool enabled);
+
+    // Drop all recorded spans
+    static void clear();
+    // Best consistent with the traced threads idle, e.g. between frames
+    static bool writeChromeTrace(const std::string &path);
+
+    // Read OCC_TRACE and OCC_TRACE_FILE, returns the dump path or empty
+    static std::string initFromEnvironment();
+
+    static int64_t nowNs();
+    static void record(const char *category, const char *name, int64_t start_ns,
+                       int64_t end_ns);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+class OccTraceScope
+{
+public:
+    OccTraceScope(const char *category, const char *name)
+        : category_(category)
+        , name_(name)
+        , start_ns_(OccTrace::isEnabled() ? OccTrace::nowNs() : -1)
+    {
+    }
+
+    ~OccTraceScope()
+    {
+        if (start_ns_ >= 0)
+        {
+            OccTrace::record(category_, name_, start_ns_, OccTrace::nowNs());
+        }
+    }
+
+    OccTraceScope(const OccTraceScope &) = delete;
+    OccTraceScope &operator=(const OccTraceScope &) = delete;
+
+private:
+    const char *category_;
+    const char *name_;
+    int64_t start_ns_;
+};
+
+} // namespace geotoys
+
+#define OCC_TRACE_CONCAT_(a, b) a##b
+#define OCC_TRACE_CONCAT(a, b) OCC_TRACE_CONCAT_(a, b)
+// category and name must be string literals
+#define OCC_TRACE_SCOPE(category, name)                                        \
+    ::geotoys::OccTraceScope OCC_TRACE_CONCAT(occTraceScope_, __LINE__)(category, name)
+
+#endif // OCCTRACE_H
@@ -1,22 +1,36 @@
 #include "OccViewerItem.h"
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include <random>
 
 #include <QColor>
+#include <QCoreApplication>
 #include <QDebug>
+#include <QFileInfo>
 #include <QOpenGLContext>
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLFunctions>
+#include <QPointer>
 #include <QQmlContext>
 #include <QQmlEngine>
 #include <QQuickItem>
 #include <QQuickWindow>
-#include <QTimer>
+#include <QRunnable>
+#include <QSGSimpleTextureNode>
 
 #include <BRepPrimAPI_MakeBox.hxx>
+#include <TopoDS_Iterator.hxx>
 
 #include "OCCRenderer.h"
+#include "OccBinaryMesh.h"
+#include "OccLog.h"
+#include "OccMeshFile.h"
 #include "OccSceneManager.h"
+#include "OccShapeIO.h"
+#include "OccTrace.h"
+#include "OccXdeImporter.h"
 
 namespace geotoys
 {
@@ -24,25 +38,167 @@ namespace geotoys
 OccViewerItem::OccViewerItem(QQuickItem *parent)
     : QQuickFramebufferObject(parent)
     , visible_(true)
+    , render_stats_(new OccRenderStats(this))
+    , update_timer_(new QTimer(this))
 {
     setMirrorVertically(true);
+    // the renderer reallocates the FBO in size buckets
+    setTextureFollowsItemSize(false);
     setAcceptHoverEvents(true);
     setAcceptedMouseButtons(Qt::AllButtons);
     setFlag(QQuickItem::ItemAcceptsInputMethod, true);
     setFlag(QQuickItem::ItemIsFocusScope, true);
     setFocus(true);
+    import_pool_.setMaxThreadCount(1);
+    update_timer_->setSingleShot(true);
+    connect(update_timer_, &QTimer::timeout, this, &QQuickItem::update);
+
+    file_loader_ = new OccFileLoader(
+        [this](const std::vector<OccShapeDesc> &shapes) { addImportedShapes(shapes, false); },
+        this);
+    connect(file_loader_, &OccFileLoader::progress, this, &OccViewerItem::loadProgress);
+    connect(file_loader_, &OccFileLoader::finished, this, &OccViewerItem::fitAll);
+    connect(file_loader_, &OccFileLoader::finished, this, &OccViewerItem::filesLoaded);
+    // read by the underlay on the render thread, which keeps drawing while
+    // the item gets no paint node updates
+    connect(this, &QQuickItem::visibleChanged, this, [this]() {
+        underlay_visible_.store(isVisible());
+        if (underlay_ && window())
+        {
+            window()->update();
+        }
+    });
 }
 
 OccViewerItem::~OccViewerItem()
 {
+    scheduleUnderlayRelease();
+    cancelImport();
+    import_pool_.clear();
+    import_pool_.waitForDone();
 }
 
 QQuickFramebufferObject::Renderer *OccViewerItem::createRenderer() const
 {
-    renderer_ = new OCCRenderer(const_cast<OccViewerItem *>(this));
+    auto *self = const_cast<OccViewerItem *>(this);
+    renderer_ = new OCCRenderer(self);
+
+    // scene manager lives on the render thread, use queued connections
+    OccSceneManager *sceneManager = renderer_->getSceneManager();
+    connect(sceneManager, &OccSceneManager::shapeReady, self,
+            &OccViewerItem::shapeReady, Qt::QueuedConnection);
+    connect(sceneManager, &OccSceneManager::shapeReady, self,
+            &OccViewerItem::onShapeReady, Qt::QueuedConnection);
+    connect(sceneManager, &OccSceneManager::shapeReady, file_loader_,
+            &OccFileLoader::shapeReady, Qt::QueuedConnection);
+    connect(sceneManager, &OccSceneManager::shapeFailed, self, &OccViewerItem::shapeFailed,
+            Qt::QueuedConnection);
+    connect(sceneManager, &OccSceneManager::shapeFailed, file_loader_,
+            &OccFileLoader::shapeFailed, Qt::QueuedConnection);
+    connect(sceneManager, &OccSceneManager::shapeCancelled, file_loader_,
+            &OccFileLoader::shapeCancelled, Qt::QueuedConnection);
+    connect(sceneManager, &OccSceneManager::meshFinished, self,
+            &QQuickItem::update, Qt::QueuedConnection);
     return renderer_;
 }
 
+QSGNode *OccViewerItem::updatePaintNode(QSGNode *node, UpdatePaintNodeData *data)
+{
+    if (!underlay_)
+    {
+        // the FBO is larger than the item, see OCCRenderer::RESIZE_BUCKET
+        auto *texture = static_cast<QSGSimpleTextureNode *>(
+            QQuickFramebufferObject::updatePaintNode(node, data));
+        if (texture != nullptr && renderer_ != nullptr)
+        {
+            texture->setSourceRect(renderer_->displayRect());
+        }
+        return texture;
+    }
+
+    // nothing in the scene graph, the view is drawn before the render pass
+    // records the QML content
+    delete node;
+    QQuickWindow *win = window();
+    if (underlay_renderer_ == nullptr)
+    {
+        underlay_renderer_ = static_cast<OCCRenderer *>(createRenderer());
+        underlay_connections_.push_back(connect(
+            win, &QQuickWindow::beforeRenderPassRecording, this,
+            [this, win]() { renderUnderlay(win); }, Qt::DirectConnection));
+        underlay_connections_.push_back(connect(win, &QQuickWindow::sceneGraphInvalidated, this,
+                                                &OccViewerItem::releaseUnderlay,
+                                                Qt::DirectConnection));
+    }
+    underlay_renderer_->synchronize(this);
+    underlay_size_ = win->size() * win->effectiveDevicePixelRatio();
+    return nullptr;
+}
+
+void OccViewerItem::renderUnderlay(QQuickWindow *win)
+{
+    if (underlay_renderer_ == nullptr || !underlay_visible_.load())
+    {
+        return;
+    }
+    win->beginExternalCommands();
+    underlay_renderer_->renderUnderlay(underlay_size_);
+    win->endExternalCommands();
+}
+
+void OccViewerItem::releaseUnderlay()
+{
+    for (const QMetaObject::Connection &connection : underlay_connections_)
+    {
+        disconnect(connection);
+    }
+    underlay_connections_.clear();
+    delete underlay_renderer_;
+    underlay_renderer_ = nullptr;
+    renderer_ = nullptr;
+}
+
+void OccViewerItem::releaseResources()
+{
+    QQuickFramebufferObject::releaseResources();
+    scheduleUnderlayRelease();
+}
+
+void OccViewerItem::scheduleUnderlayRelease()
+{
+    if (underlay_renderer_ == nullptr || window() == nullptr)
+    {
+        return;
+    }
+    for (const QMetaObject::Connection &connection : underlay_connections_)
+    {
+        disconnect(connection);
+    }
+    underlay_connections_.clear();
+    OCCRenderer *renderer = underlay_renderer_;
+    underlay_renderer_ = nullptr;
+    renderer_ = nullptr;
+    window()->scheduleRenderJob(QRunnable::create([renderer]() { delete renderer; }),
+                                QQuickWindow::BeforeSynchronizingStage);
+}
+
+void OccViewerItem::setUnderlay(bool enabled)
+{
+    if (underlay_ == enabled)
+    {
+        return;
+    }
+    // the FBO node or the underlay renderer exists from the first frame on
+    if (renderer_ != nullptr)
+    {
+        qCWarning(lcOccRender) << "underlay can only be set before the first frame";
+        return;
+    }
+    underlay_ = enabled;
+    Q_EMIT underlayChanged();
+    update();
+}
+
 void OccViewerItem::setWindowVisible(bool visible)
 {
     if (visible_ != visible)
@@ -54,161 +210,779 @@ void OccViewerItem::setWindowVisible(bool visible)
     }
 }
 
+void OccViewerItem::setLodPixelError(double pixels)
+{
+    if (pixels > 0.0 && !qFuzzyCompare(lod_pixel_error_, pixels))
+    {
+        lod_pixel_error_ = pixels;
+        Q_EMIT lodPixelErrorChanged();
+        update();
+    }
+}
+
+void OccViewerItem::setAdaptiveResolution(bool enabled)
+{
+    if (resolution_.enabled != enabled)
+    {
+        resolution_.enabled = enabled;
+        Q_EMIT resolutionSettingsChanged();
+        update();
+    }
+}
+
+void OccViewerItem::setTargetFrameTime(double ms)
+{
+    if (ms > 0.0 && !qFuzzyCompare(resolution_.target_frame_ms, ms))
+    {
+        resolution_.target_frame_ms = ms;
+        Q_EMIT resolutionSettingsChanged();
+    }
+}
+
+void OccViewerItem::setMinResolutionScale(double scale)
+{
+    if (scale > 0.0 && !qFuzzyCompare(resolution_.min_scale, scale))
+    {
+        resolution_.min_scale = scale;
+        Q_EMIT resolutionSettingsChanged();
+    }
+}
+
+void OccViewerItem::setMaxResolutionScale(double scale)
+{
+    if (scale > 0.0 && !qFuzzyCompare(resolution_.max_scale, scale))
+    {
+        resolution_.max_scale = scale;
+        Q_EMIT resolutionSettingsChanged();
+        update();
+    }
+}
+
 void OccViewerItem::toggleWindow()
 {
     setWindowVisible(!visible_);
 }
 
-OccSceneManager *OccViewerItem::getSceneManager() const
+void OccViewerItem::updateAfter(int ms)
+{
+    update_timer_->start(ms);
+}
+
+void OccViewerItem::enqueue(OccSceneCommand command)
 {
-    return renderer_->getSceneManager();
+    command_queue_.push(std::move(command));
+    update();
+
+    // every id change goes along with a scene command
+    if (shape_ids_.hasChanges() && !id_changes_queued_)
+    {
+        id_changes_queued_ = true;
+        QMetaObject::invokeMethod(this, &OccViewerItem::emitShapeIdChanges,
+                                  Qt::QueuedConnection);
+    }
+}
+
+void OccViewerItem::emitShapeIdChanges()
+{
+    id_changes_queued_ = false;
+    QStringList added;
+    QStringList removed;
+    bool reset = false;
+    shape_ids_.takeChanges(added, removed, reset);
+    if (reset || !added.isEmpty() || !removed.isEmpty())
+    {
+        Q_EMIT shapeIdsChanged(added, removed, reset);
+    }
 }
 
-bool OccViewerItem::addShape(const QString & /*id*/,
-                             const QVariant & /*shapeData*/,
-                             const QColor & /*color*/, bool /*display*/)
+bool OccViewerItem::addShape(const QString &id, const QVariant &shapeData,
+                             const QColor &color, bool display)
 {
-    qWarning()
-        << "addShape not implemented yet - need to convert QVariant to TopoDS_Shape";
-    return false;
+    if (shapeData.typeId() != QMetaType::QByteArray)
+    {
+        qWarning() << "addShape expects a binary mesh, got" << shapeData.typeName();
+        return false;
+    }
+
+    // the only copy of the arrays, straight into the triangulation
+    Handle(Poly_Triangulation) triangulation;
+    Handle(TColStd_HArray1OfInteger) colors;
+    std::string error;
+    if (!OccBinaryMesh::read(shapeData.toByteArray(), triangulation, colors, &error))
+    {
+        qWarning() << "addShape:" << id << error.c_str();
+        return false;
+    }
+
+    shape_ids_.insert(id);
+    shape_ids_.setMeshVertices(id, uint32_t(triangulation->NbNodes()));
+    Quantity_Color occColor(color.redF(), color.greenF(), color.blueF(),
+                            Quantity_TOC_RGB);
+    enqueue([key = shape_ids_.key(id), triangulation, colors, occColor,
+             display](OCCRenderer &renderer) {
+        renderer.getSceneManager()->addMesh(key, triangulation, colors, occColor, display);
+    });
+    return true;
 }
 
 bool OccViewerItem::removeShape(const QString &id)
 {
-    if (auto sceneManager = getSceneManager())
+    std::string key = shape_ids_.key(id);
+    if (!shape_ids_.remove(id))
+    {
+        return false;
+    }
+
+    enqueue([key = std::move(key)](OCCRenderer &renderer) {
+        renderer.getSceneManager()->removeShape(key);
+    });
+    return true;
+}
+
+bool OccViewerItem::updateShape(const QString &id, const QVariant &shapeData)
+{
+    if (!shape_ids_.contains(id) || shapeData.typeId() != QMetaType::QByteArray)
+    {
+        return false;
+    }
+
+    const QByteArray data = shapeData.toByteArray();
+    OccBinaryMesh::Header header;
+    std::string error;
+    if (!OccBinaryMesh::readHeader(data, header, &error))
+    {
+        qWarning() << "updateShape:" << id << error.c_str();
+        return false;
+    }
+
+    if (header.triangle_count == 0)
     {
-        bool result = sceneManager->removeShape(id.toStdString());
-        if (result)
+        if (header.vertex_count == 0 || header.vertex_count != shape_ids_.meshVertices(id))
         {
-            // 强制更新渲染
-            update();
+            qWarning() << "updateShape:" << id << "vertices do not match a mesh";
+            return false;
         }
-        return result;
+        // the buffer is shared, not copied, and read into the existing
+        // triangulation on the render thread
+        enqueue([key = shape_ids_.key(id), data](OCCRenderer &renderer) {
+            renderer.getSceneManager()->updateMeshVertices(key, data);
+        });
+        return true;
+    }
+
+    Handle(Poly_Triangulation) triangulation;
+    Handle(TColStd_HArray1OfInteger) colors;
+    if (!OccBinaryMesh::read(data, triangulation, colors, &error))
+    {
+        qWarning() << "updateShape:" << id << error.c_str();
+        return false;
     }
-    return false;
+    shape_ids_.setMeshVertices(id, uint32_t(triangulation->NbNodes()));
+    enqueue([key = shape_ids_.key(id), triangulation, colors](OCCRenderer &renderer) {
+        OccSceneManager *sceneManager = renderer.getSceneManager();
+        // keep the color of the replaced object
+        Quantity_Color color = Quantity_NOC_YELLOW;
+        Handle(AIS_InteractiveObject) previous = sceneManager->getObject(key);
+        if (!previous.IsNull() && previous->HasColor())
+        {
+            previous->Color(color);
+        }
+        sceneManager->addMesh(key, triangulation, colors, color, true);
+    });
+    return true;
 }
 
-bool OccViewerItem::updateShape(const QString & /*id*/,
-                                const QVariant & /*shapeData*/)
+bool OccViewerItem::setShapeColor(const QString &id, const QColor &color)
 {
-    qWarning()
-        << "updateShape not implemented yet - need to convert QVariant to TopoDS_Shape";
-    return false;
+    if (!shape_ids_.contains(id))
+    {
+        return false;
+    }
+
+    Quantity_Color occColor(color.redF(), color.greenF(), color.blueF(),
+                            Quantity_TOC_RGB);
+    enqueue([key = shape_ids_.key(id), occColor](OCCRenderer &renderer) {
+        renderer.getSceneManager()->setShapeColor(key, occColor);
+    });
+    return true;
 }
 
-bool OccViewerItem::setShapeColor(const QString &id, const QColor &color)
+bool OccViewerItem::setShapeVisible(const QString &id, bool visible)
 {
-    if (auto sceneManager = getSceneManager())
+    if (!shape_ids_.contains(id))
     {
-        Quantity_Color occColor(color.red(), color.green(), color.blue(),
-                                Quantity_TOC_RGB);
-        return sceneManager->setShapeColor(id.toStdString(), occColor);
+        return false;
     }
-    return false;
+
+    enqueue([key = shape_ids_.key(id), visible](OCCRenderer &renderer) {
+        renderer.getSceneManager()->setShapeVisible(key, visible);
+    });
+    return true;
 }
 
 QStringList OccViewerItem::getAllShapeIds() const
 {
-    if (auto sceneManager = getSceneManager())
+    QStringList result = shape_ids_.ids();
+    result.sort();
+    return result;
+}
+
+int OccViewerItem::shapeCount() const
+{
+    return shape_ids_.size();
+}
+
+void OccViewerItem::clearAllShapes()
+{
+    // loads waiting for their shapes would never finish
+    file_loader_->cancel();
+    shape_ids_.clear();
+    enqueue([](OCCRenderer &renderer) {
+        renderer.getSceneManager()->clearAllShapes();
+    });
+}
+
+int OccViewerItem::removeShapes(const QStringList &ids)
+{
+    std::vector<std::string> removed;
+    removed.reserve(ids.size());
+    for (const QString &id : ids)
     {
-        std::vector<std::string> ids = sceneManager->getAllShapeIds();
-        QStringList result;
-        for (const auto &id : ids)
+        std::string key = shape_ids_.key(id);
+        if (shape_ids_.remove(id))
         {
-            result.append(QString::fromStdString(id));
+            removed.push_back(std::move(key));
         }
-        return result;
     }
-    return QStringList();
+    if (removed.empty())
+    {
+        return 0;
+    }
+
+    const int count = static_cast<int>(removed.size());
+    enqueue([removed = std::move(removed)](OCCRenderer &renderer) {
+        renderer.getSceneManager()->removeShapes(removed);
+    });
+    return count;
 }
 
-void OccViewerItem::clearAllShapes()
+int OccViewerItem::setShapesColor(const QStringList &ids, const QColor &color)
 {
-    if (auto sceneManager = getSceneManager())
+    std::vector<std::string> known;
+    known.reserve(ids.size());
+    for (const QString &id : ids)
     {
-        sceneManager->clearAllShapes();
-        // 强制更新渲染
-        update();
+        if (shape_ids_.contains(id))
+        {
+            known.push_back(shape_ids_.key(id));
+        }
+    }
+    if (known.empty())
+    {
+        return 0;
+    }
+
+    const int count = static_cast<int>(known.size());
+    Quantity_Color occColor(color.redF(), color.greenF(), color.blueF(),
+                            Quantity_TOC_RGB);
+    enqueue([known = std::move(known), occColor](OCCRenderer &renderer) {
+        OccSceneManager *sceneManager = renderer.getSceneManager();
+        for (const std::string &id : known)
+        {
+            sceneManager->setShapeColor(id, occColor);
+        }
+    });
+    return count;
+}
+
+QStringList OccViewerItem::shapeIdsUnder(const QString &prefix) const
+{
+    return shape_ids_.idsUnder(prefix);
+}
+
+int OccViewerItem::removeShapesUnder(const QString &prefix)
+{
+    std::vector<std::string> removed = shape_ids_.keysUnder(prefix);
+    if (removed.empty())
+    {
+        return 0;
+    }
+    for (const QString &id : shape_ids_.idsUnder(prefix))
+    {
+        shape_ids_.remove(id);
+    }
+
+    const int count = static_cast<int>(removed.size());
+    enqueue([removed = std::move(removed)](OCCRenderer &renderer) {
+        renderer.getSceneManager()->removeShapes(removed);
+    });
+    return count;
+}
+
+int OccViewerItem::setShapesColorUnder(const QString &prefix, const QColor &color)
+{
+    // "plant/" and "plant" name the same group
+    const QString path = OccIdRegistry::groupPath(prefix);
+    const int count = static_cast<int>(shape_ids_.keysUnder(path).size());
+    if (count == 0)
+    {
+        return 0;
     }
+
+    // the scene groups of the renderer follow the same paths
+    Quantity_Color occColor(color.redF(), color.greenF(), color.blueF(),
+                            Quantity_TOC_RGB);
+    enqueue([path = path.toStdString(), occColor](OCCRenderer &renderer) {
+        renderer.getSceneManager()->setGroupColor(path, occColor);
+    });
+    return count;
+}
+
+int OccViewerItem::setShapesVisibleUnder(const QString &prefix, bool visible)
+{
+    const QString path = OccIdRegistry::groupPath(prefix);
+    const int count = static_cast<int>(shape_ids_.keysUnder(path).size());
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    enqueue([path = path.toStdString(), visible](OCCRenderer &renderer) {
+        renderer.getSceneManager()->setGroupVisible(path, visible);
+    });
+    return count;
+}
+
+void OccViewerItem::setMeshCache(const QString &directory, int maxMegabytes)
+{
+    if (directory.isEmpty())
+    {
+        mesh_cache_.reset();
+    }
+    else
+    {
+        mesh_cache_ = std::make_shared<OccMeshCache>(
+            directory.toStdString(), uint64_t(std::max(maxMegabytes, 0)) << 20);
+    }
+
+    enqueue([cache = mesh_cache_](OCCRenderer &renderer) {
+        renderer.getSceneManager()->setMeshCache(cache);
+    });
+}
+
+QVariantMap OccViewerItem::meshCacheStats() const
+{
+    const OccMeshCacheStats stats =
+        mesh_cache_ ? mesh_cache_->stats() : OccMeshCacheStats();
+    QVariantMap result;
+    result["hits"] = qulonglong(stats.hits);
+    result["misses"] = qulonglong(stats.misses);
+    result["stores"] = qulonglong(stats.stores);
+    result["evictions"] = qulonglong(stats.evictions);
+    result["sizeBytes"] = qulonglong(stats.size_bytes);
+    return result;
+}
+
+void OccViewerItem::setMemoryBudget(int megabytes)
+{
+    const uint64_t bytes = uint64_t(std::max(megabytes, 0)) << 20;
+    enqueue([bytes](OCCRenderer &renderer) {
+        renderer.getSceneManager()->setMemoryBudget(bytes);
+    });
+}
+
+void OccViewerItem::setTracingEnabled(bool enabled)
+{
+    OccTrace::setEnabled(enabled);
+}
+
+bool OccViewerItem::writeTrace(const QString &path)
+{
+    return OccTrace::writeChromeTrace(path.toStdString());
 }
 
 void OccViewerItem::mousePressEvent(QMouseEvent *event)
 {
-    renderer_->handleMousePressEvent(event);
-    update();
+    OCC_TRACE_SCOPE("input", "OccViewerItem::mousePressEvent");
+    OccInputEvent input;
+    input.type = OccInputEvent::Type::Press;
+    input.position = event->position();
+    input.buttons = event->button();
+    input.modifiers = event->modifiers();
+    pushInput(input);
 }
 
 void OccViewerItem::mouseReleaseEvent(QMouseEvent *event)
 {
-    renderer_->handleMouseReleaseEvent(event);
-    update();
+    OCC_TRACE_SCOPE("input", "OccViewerItem::mouseReleaseEvent");
+    OccInputEvent input;
+    input.type = OccInputEvent::Type::Release;
+    input.position = event->position();
+    input.buttons = event->buttons();
+    input.modifiers = event->modifiers();
+    pushInput(input);
 }
 
 void OccViewerItem::mouseMoveEvent(QMouseEvent *event)
 {
-    renderer_->handleMouseMoveEvent(event);
-    update();
+    OCC_TRACE_SCOPE("input", "OccViewerItem::mouseMoveEvent");
+    OccInputEvent input;
+    input.type = OccInputEvent::Type::Move;
+    input.position = event->position();
+    input.modifiers = event->modifiers();
+    pushInput(input);
 }
 
 void OccViewerItem::wheelEvent(QWheelEvent *event)
 {
-    renderer_->handleWheelEvent(event);
-    update();
+    OCC_TRACE_SCOPE("input", "OccViewerItem::wheelEvent");
+    OccInputEvent input;
+    input.type = OccInputEvent::Type::Wheel;
+    input.position = event->position();
+    input.modifiers = event->modifiers();
+    input.wheel_delta = double(event->angleDelta().y()) / 8.0;
+    pushInput(input);
 }
 
 void OccViewerItem::hoverMoveEvent(QHoverEvent *event)
 {
+    OCC_TRACE_SCOPE("input", "OccViewerItem::hoverMoveEvent");
     if (event->position().toPoint() == last_mouse_pos_)
     {
         return;
     }
 
     last_mouse_pos_ = event->position().toPoint();
-    renderer_->handleHoverMoveEvent(event);
-    update();
+    OccInputEvent input;
+    input.type = OccInputEvent::Type::Hover;
+    input.position = event->position();
+    input.modifiers = event->modifiers();
+    pushInput(input);
+}
+
+void OccViewerItem::pushInput(const OccInputEvent &event)
+{
+    // applied by the renderer in the next synchronize(), the underlay view
+    // covers the window
+    // one frame per batch, later events are merged into the queue
+    const bool first = input_queue_.isEmpty();
+    if (underlay_)
+    {
+        OccInputEvent mapped = event;
+        mapped.position = mapToScene(event.position);
+        input_queue_.push(mapped);
+    }
+    else
+    {
+        input_queue_.push(event);
+    }
+    if (first)
+    {
+        update();
+    }
 }
 
 void OccViewerItem::fitAll()
 {
-    renderer_->fitAll();
-    update();
+    enqueue([](OCCRenderer &renderer) { renderer.fitAll(); });
 }
 
-void OccViewerItem::addTestShape()
+void OccViewerItem::importStepAssembly(const QString &path, const QString &idPrefix)
+{
+    import_pool_.start([this, path, idPrefix]() {
+        OCC_TRACE_SCOPE("io", "OccViewerItem::importStepAssembly");
+        auto assembly = std::make_shared<OccXdeAssembly>();
+        std::string error;
+        const bool ok = OccXdeImporter::readStep(path.toStdString(),
+                                                 idPrefix.toStdString(), *assembly, &error);
+        if (!ok)
+        {
+            qWarning() << "STEP assembly import failed:" << error.c_str();
+        }
+
+        QMetaObject::invokeMethod(
+            this,
+            [this, path, ok, assembly]() {
+                if (ok)
+                {
+                    for (const OccXdeInstance &instance : assembly->instances)
+                    {
+                        shape_ids_.insert(QString::fromStdString(instance.id));
+                    }
+                    enqueue([assembly](OCCRenderer &renderer) {
+                        renderer.getSceneManager()->addAssembly(*assembly);
+                        renderer.fitAll();
+                    });
+                }
+                Q_EMIT assemblyImported(path, ok, int(assembly->instances.size()),
+                                        int(assembly->prototypes.size()));
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+bool OccViewerItem::importModel(const QString &path, const QString &idPrefix)
 {
-    auto sceneManager = getSceneManager();
-    if (!sceneManager)
+    if (importing_ || !OccShapeIO::isSupported(path.toStdString()))
     {
-        return;
+        return false;
     }
 
-    TopoDS_Shape aBox = BRepPrimAPI_MakeBox(100.0, 50.0, 90.0).Shape();
-    sceneManager->addShape("test_box", aBox, Quantity_NOC_YELLOW, true);
-    renderer_->fitAll();
-    update();
+    importing_ = true;
+    import_progress_ = 0.0;
+    first_geometry_ms_ = -1.0;
+    import_prefix_ = idPrefix;
+    import_timer_.start();
+    import_cancel_ = std::make_shared<std::atomic_bool>(false);
+    Q_EMIT importStateChanged();
+
+    import_pool_.start([this, path, idPrefix, cancel = import_cancel_]() {
+        OCC_TRACE_SCOPE("io", "OccViewerItem::importModel");
+        const std::string prefix = idPrefix.toStdString();
+        int rootCount = 0;
+        int shapeCount = 0;
+
+        // every translated root goes to the scene right away, compounds are
+        // split so that their parts are meshed in parallel
+        auto onShape = [&](int /*root*/, const TopoDS_Shape &shape) {
+            auto chunk = std::make_shared<std::vector<OccShapeDesc>>();
+            const std::string rootId = prefix + "/root" + std::to_string(++rootCount);
+            if (shape.ShapeType() == TopAbs_COMPOUND)
+            {
+                int index = 0;
+                for (TopoDS_Iterator it(shape); it.More(); it.Next())
+                {
+                    OccShapeDesc desc;
+                    desc.id = rootId + "/" + std::to_string(index++);
+                    desc.shape = it.Value();
+                    chunk->push_back(std::move(desc));
+                }
+            }
+            else
+            {
+                OccShapeDesc desc;
+                desc.id = rootId;
+                desc.shape = shape;
+                chunk->push_back(std::move(desc));
+            }
+            shapeCount += int(chunk->size());
+            QMetaObject::invokeMethod(
+                this,
+                [this, cancel, chunk]() {
+                    if (cancel == import_cancel_ && !cancel->load())
+                    {
+                        // fit until the first shape shows up, the camera
+                        // must not jump later on
+                        addImportedShapes(*chunk, first_geometry_ms_ < 0.0);
+                    }
+                },
+                Qt::QueuedConnection);
+        };
+
+        auto onProgress = [this, cancel](double position) {
+            QMetaObject::invokeMethod(
+                this,
+                [this, cancel, position]() {
+                    if (cancel == import_cancel_ && importing_)
+                    {
+                        import_progress_ = position;
+                        Q_EMIT importStateChanged();
+                    }
+                },
+                Qt::QueuedConnection);
+        };
+
+        std::string error;
+        bool ok = false;
+        const std::string file = path.toStdString();
+        const QString suffix = QFileInfo(path).suffix().toLower();
+        if (suffix == "step" || suffix == "stp")
+        {
+            Handle(OccReadProgress) progress = new OccReadProgress(onProgress, cancel);
+            ok = OccShapeIO::readStepRoots(file, onShape, progress->Start(), &error);
+        }
+        else
+        {
+            // other formats are read in one piece
+            const TopoDS_Shape shape = OccShapeIO::readFile(file, &error);
+            ok = !shape.IsNull() && !cancel->load();
+            if (ok)
+            {
+                onShape(1, shape);
+            }
+        }
+        if (!ok && !cancel->load())
+        {
+            qWarning() << "Import failed:" << error.c_str();
+        }
+
+        QMetaObject::invokeMethod(
+            this,
+            [this, path, ok, cancel, shapeCount]() {
+                if (cancel != import_cancel_)
+                {
+                    return;
+                }
+                importing_ = false;
+                if (ok)
+                {
+                    import_progress_ = 1.0;
+                }
+                qCDebug(lcOccScene) << "Import of" << path << "finished after"
+                                    << import_timer_.elapsed() << "ms," << shapeCount
+                                    << "shapes, first geometry after" << first_geometry_ms_
+                                    << "ms";
+                Q_EMIT importStateChanged();
+                Q_EMIT importFinished(path, ok, cancel->load(), shapeCount);
+            },
+            Qt::QueuedConnection);
+    });
+    return true;
 }
 
-void OccViewerItem::removeTestShape()
+bool OccViewerItem::loadFiles(const QStringList &paths, const QString &idPrefix, int threads)
+{
+    OccFileLoadSettings settings = file_loader_->settings();
+    settings.threads = std::max(threads, 0);
+    file_loader_->setSettings(settings);
+    return file_loader_->load(paths, idPrefix);
+}
+
+void OccViewerItem::cancelLoad()
+{
+    file_loader_->cancel();
+}
+
+bool OccViewerItem::loadMeshFile(const QString &path)
 {
-    auto sceneManager = getSceneManager();
-    if (!sceneManager)
+    QElapsedTimer timer;
+    timer.start();
+    std::string error;
+    std::shared_ptr<OccMeshFile> file = OccMeshFile::open(path.toStdString(), &error);
+    if (!file)
     {
-        return;
+        qWarning() << "loadMeshFile:" << error.c_str();
+        return false;
+    }
+    for (const OccMeshFile::Object &object : file->objects())
+    {
+        const QString id = QString::fromStdString(object.id);
+        shape_ids_.insert(id);
+        shape_ids_.setMeshVertices(id, uint32_t(object.triangulation->NbNodes()));
     }
-    sceneManager->removeShape("test_box");
+    qCDebug(lcOccScene) << "Mapped" << file->objects().size() << "meshes from" << path
+                        << "in" << timer.elapsed() << "ms";
 
-    renderer_->fitAll();
-    update();
+    enqueue([file](OCCRenderer &renderer) {
+        renderer.getSceneManager()->addMeshFile(file);
+        renderer.fitAll();
+    });
+    return true;
 }
 
-void OccViewerItem::updateTestShape()
+void OccViewerItem::saveMeshFile(const QString &path)
 {
-    // change size and color
-    auto sceneManager = getSceneManager();
-    if (!sceneManager)
+    // written on a worker, the item may be gone by then
+    enqueue([item = QPointer<OccViewerItem>(this), path](OCCRenderer &renderer) {
+        renderer.getSceneManager()->saveMeshFile(
+            path.toStdString(), [item, path](bool ok, const std::string &error) {
+                if (!ok)
+                {
+                    qWarning() << "saveMeshFile:" << error.c_str();
+                }
+                QMetaObject::invokeMethod(
+                    qApp,
+                    [item, path, ok]() {
+                        if (item)
+                        {
+                            Q_EMIT item->meshFileSaved(path, ok);
+                        }
+                    },
+                    Qt::QueuedConnection);
+            });
+    });
+}
+
+int OccViewerItem::grabAsync(const QSize &size)
+{
+    const int request = ++next_grab_;
+    // the grab can complete after the item is gone
+    enqueue([item = QPointer<OccViewerItem>(this), request, size](OCCRenderer &renderer) {
+        renderer.requestGrab(size, [item, request](const QImage &image, double latencyMs) {
+            QMetaObject::invokeMethod(
+                qApp,
+                [item, request, image, latencyMs]() {
+                    if (item)
+                    {
+                        Q_EMIT item->frameGrabbed(request, image, latencyMs);
+                    }
+                },
+                Qt::QueuedConnection);
+        });
+    });
+    return request;
+}
+
+void OccViewerItem::cancelImport()
+{
+    if (import_cancel_)
+    {
+        import_cancel_->store(true);
+    }
+}
+
+void OccViewerItem::addImportedShapes(const std::vector<OccShapeDesc> &shapes, bool fit)
+{
+    for (const OccShapeDesc &desc : shapes)
+    {
+        shape_ids_.insert(QString::fromStdString(desc.id));
+    }
+    enqueue([shapes, fit](OCCRenderer &renderer) {
+        renderer.getSceneManager()->addShapesAsync(shapes);
+        if (fit)
+        {
+            renderer.fitAll();
+        }
+    });
+}
+
+void OccViewerItem::onShapeReady(const QString &id)
+{
+    if (first_geometry_ms_ >= 0.0 || !import_timer_.isValid() ||
+        !id.startsWith(import_prefix_ + '/'))
     {
         return;
     }
+    first_geometry_ms_ = double(import_timer_.nsecsElapsed()) / 1.0e6;
+    qCDebug(lcOccScene) << "First geometry of import after" << first_geometry_ms_ << "ms";
+    Q_EMIT importStateChanged();
+}
+
+void OccViewerItem::addTestShape()
+{
+    shape_ids_.insert("test_box");
+    enqueue([](OCCRenderer &renderer) {
+        TopoDS_Shape aBox = BRepPrimAPI_MakeBox(100.0, 50.0, 90.0).Shape();
+        renderer.getSceneManager()->addShape("test_box", aBox,
+                                             Quantity_NOC_YELLOW, true);
+        renderer.fitAll();
+    });
+}
+
+void OccViewerItem::removeTestShape()
+{
+    shape_ids_.remove("test_box");
+    enqueue([](OCCRenderer &renderer) {
+        renderer.getSceneManager()->removeShape("test_box");
+        renderer.fitAll();
+    });
+}
+
+void OccViewerItem::updateTestShape()
+{
+    // change size and color
+    shape_ids_.insert("test_box");
+
     // get rand size and color
     std::random_device rd;
     std::mt19937 gen(rd());
@@ -218,11 +992,43 @@ void OccViewerItem::updateTestShape()
     double rand_scale = dis(gen);
     TopoDS_Shape aBox =
         BRepPrimAPI_MakeBox(size, rand_scale * size, rand_scale * size).Shape();
-    sceneManager->updateShape("test_box", aBox);
-    sceneManager->setShapeColor(
-        "test_box", Quantity_Color(color, rand_scale * color,
-                                   rand_scale * color, Quantity_TOC_RGB));
-    renderer_->fitAll();
-    update();
+    Quantity_Color aColor(color, rand_scale * color, rand_scale * color,
+                          Quantity_TOC_RGB);
+    enqueue([aBox, aColor](OCCRenderer &renderer) {
+        OccSceneManager *sceneManager = renderer.getSceneManager();
+        sceneManager->updateShape("test_box", aBox);
+        sceneManager->setShapeColor("test_box", aColor);
+        renderer.fitAll();
+    });
+}
+
+void OccViewerItem::addTestShapes(int count)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    // square grid of boxes, meshed in background
+    const int side = static_cast<int>(std::ceil(std::sqrt(double(count))));
+    std::vector<OccShapeDesc> shapes;
+    shapes.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        const gp_Pnt corner((i % side) * 20.0, (i / side) * 20.0, 0.0);
+        OccShapeDesc desc;
+        desc.id = "test_grid/box_" + std::to_string(i);
+        desc.shape = BRepPrimAPI_MakeBox(corner, 10.0, 10.0, 10.0).Shape();
+        desc.color = Quantity_Color(double(i % side) / side,
+                                    double(i / side) / side, 0.5,
+                                    Quantity_TOC_RGB);
+        shape_ids_.insert(QString::fromStdString(desc.id));
+        shapes.push_back(std::move(desc));
+    }
+
+    enqueue([shapes = std::move(shapes)](OCCRenderer &renderer) {
+        renderer.getSceneManager()->addShapesAsync(shapes);
+        renderer.fitAll();
+    });
 }
 } // namespace geotoys
@@ -1,10 +1,20 @@
 #ifndef QMLOCCVIEWER_H
 #define QMLOCCVIEWER_H
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 #include <QColor>
+#include <QElapsedTimer>
+#include <QImage>
 #include <QOpenGLFramebufferObject>
 #include <QQuickFramebufferObject>
+#include <QQuickWindow>
+#include <QThreadPool>
+#include <QTimer>
 #include <QVariant>
+#include <QVariantMap>
 
 #include <AIS_InteractiveContext.hxx>
 #include <AIS_Shape.hxx>
@@ -15,6 +25,12 @@
 #include <V3d_View.hxx>
 #include <V3d_Viewer.hxx>
 
+#include "OccCommandQueue.h"
+#include "OccFileLoader.h"
+#include "OccIdRegistry.h"
+#include "OccInputQueue.h"
+#include "OccRenderStats.h"
+#include "OccResolutionController.h"
 #include "OccSceneManager.h"
 
 namespace geotoys
@@ -26,6 +42,32 @@ class OccViewerItem : public QQuickFramebufferObject
     Q_OBJECT
     Q_PROPERTY(bool windowVisible READ windowVisible WRITE setWindowVisible
                    NOTIFY windowVisibleChanged)
+    // Level of detail target: maximal projected chordal deflection in pixels
+    Q_PROPERTY(double lodPixelError READ lodPixelError WRITE setLodPixelError
+                   NOTIFY lodPixelErrorChanged)
+    // Dynamic resolution: lower the render scale during interaction to keep
+    // the frame time within targetFrameTime (ms)
+    Q_PROPERTY(bool adaptiveResolution READ adaptiveResolution WRITE
+                   setAdaptiveResolution NOTIFY resolutionSettingsChanged)
+    Q_PROPERTY(double targetFrameTime READ targetFrameTime WRITE
+                   setTargetFrameTime NOTIFY resolutionSettingsChanged)
+    Q_PROPERTY(double minResolutionScale READ minResolutionScale WRITE
+                   setMinResolutionScale NOTIFY resolutionSettingsChanged)
+    Q_PROPERTY(double maxResolutionScale READ maxResolutionScale WRITE
+                   setMaxResolutionScale NOTIFY resolutionSettingsChanged)
+    // Rolling per phase frame timings and draw counters
+    Q_PROPERTY(geotoys::OccRenderStats *renderStats READ renderStats CONSTANT)
+    // Streaming import state, progress in [0, 1]. timeToFirstGeometry is the
+    // time from importModel() to the first displayed shape, -1 until known.
+    Q_PROPERTY(bool importing READ importing NOTIFY importStateChanged)
+    Q_PROPERTY(double importProgress READ importProgress NOTIFY importStateChanged)
+    Q_PROPERTY(double timeToFirstGeometry READ timeToFirstGeometry NOTIFY
+                   importStateChanged)
+    // Draw the view into the window's framebuffer below the QML content
+    // instead of through an FBO texture. The view then covers the whole
+    // window, meant for an item filling it with transparent items between
+    // it and the window. Only honored before the first frame.
+    Q_PROPERTY(bool underlay READ underlay WRITE setUnderlay NOTIFY underlayChanged)
 
 public:
     OccViewerItem(QQuickItem *parent = nullptr);
@@ -39,24 +81,160 @@ public:
     }
     void setWindowVisible(bool visible);
 
+    double lodPixelError() const
+    {
+        return lod_pixel_error_;
+    }
+    void setLodPixelError(double pixels);
+
+    bool adaptiveResolution() const
+    {
+        return resolution_.enabled;
+    }
+    void setAdaptiveResolution(bool enabled);
+    double targetFrameTime() const
+    {
+        return resolution_.target_frame_ms;
+    }
+    void setTargetFrameTime(double ms);
+    double minResolutionScale() const
+    {
+        return resolution_.min_scale;
+    }
+    void setMinResolutionScale(double scale);
+    double maxResolutionScale() const
+    {
+        return resolution_.max_scale;
+    }
+    void setMaxResolutionScale(double scale);
+    const OccResolutionSettings &resolutionSettings() const
+    {
+        return resolution_;
+    }
+
+    OccRenderStats *renderStats() const
+    {
+        return render_stats_;
+    }
+
+    bool importing() const
+    {
+        return importing_;
+    }
+    double importProgress() const
+    {
+        return import_progress_;
+    }
+    double timeToFirstGeometry() const
+    {
+        return first_geometry_ms_;
+    }
+
+    bool underlay() const
+    {
+        return underlay_;
+    }
+    void setUnderlay(bool enabled);
+
     Q_INVOKABLE void toggleWindow();
 
+    // shapeData is a binary triangle mesh (ArrayBuffer / QByteArray), see
+    // OccBinaryMesh. updateShape with a vertex only payload (triangle_count
+    // 0) rewrites the vertex data of the mesh in place, it returns false
+    // unless id is a mesh with the same vertex count. Later failures on the
+    // render thread are reported through shapeFailed().
     Q_INVOKABLE bool addShape(const QString &id, const QVariant &shapeData,
                               const QColor &color, bool display);
     Q_INVOKABLE bool removeShape(const QString &id);
     Q_INVOKABLE bool updateShape(const QString &id, const QVariant &shapeData);
     Q_INVOKABLE bool setShapeColor(const QString &id, const QColor &color);
+    // Hidden shapes keep their id, their memory may be evicted, see
+    // setMemoryBudget()
+    Q_INVOKABLE bool setShapeVisible(const QString &id, bool visible);
     Q_INVOKABLE QStringList getAllShapeIds() const;
+    Q_INVOKABLE int shapeCount() const;
     Q_INVOKABLE void clearAllShapes();
+
+    // Batch variants, applied by the renderer as one scene transaction
+    Q_INVOKABLE int removeShapes(const QStringList &ids);
+    Q_INVOKABLE int setShapesColor(const QStringList &ids, const QColor &color);
+
+    // Groups on '/' separated ids: prefix itself and everything below it,
+    // e.g. "assembly/sub1"
+    Q_INVOKABLE QStringList shapeIdsUnder(const QString &prefix) const;
+    Q_INVOKABLE int removeShapesUnder(const QString &prefix);
+    Q_INVOKABLE int setShapesColorUnder(const QString &prefix, const QColor &color);
+    Q_INVOKABLE int setShapesVisibleUnder(const QString &prefix, bool visible);
     Q_INVOKABLE void fitAll();
 
+    // Reads a STEP assembly on a worker thread, parts used several times are
+    // meshed once and shown as instances. Ids are idPrefix/assembly/path.
+    Q_INVOKABLE void importStepAssembly(const QString &path, const QString &idPrefix);
+
+    // Reads a model file on a worker thread. STEP roots are added to the
+    // scene one by one while the rest is still translated, shapes get ids
+    // idPrefix/root<n>[/<k>]. Returns false while another import runs.
+    Q_INVOKABLE bool importModel(const QString &path, const QString &idPrefix);
+    Q_INVOKABLE void cancelImport();
+
+    // Reads, heals and meshes many files concurrently, ids are
+    // idPrefix/<file base name>. threads 0 uses the core count, 1 reads the
+    // files one after another as a baseline. Returns false while loading.
+    Q_INVOKABLE bool loadFiles(const QStringList &paths, const QString &idPrefix,
+                               int threads = 0);
+    Q_INVOKABLE void cancelLoad();
+
+    // Pre-tessellated scene files (OccMeshFile). Loading maps the file and
+    // shows its meshes without parsing, saving dumps the triangulations of
+    // everything currently displayed on a worker thread; meshFileSaved()
+    // reports the result.
+    Q_INVOKABLE bool loadMeshFile(const QString &path);
+    Q_INVOKABLE void saveMeshFile(const QString &path);
+
+    // Persistent triangulation cache, an empty directory disables it
+    Q_INVOKABLE void setMeshCache(const QString &directory, int maxMegabytes);
+    // hits, misses, stores, evictions and sizeBytes of the mesh cache
+    Q_INVOKABLE QVariantMap meshCacheStats() const;
+    // Estimated triangulation and presentation memory above which hidden
+    // shapes are evicted, least recently hidden first. 0 disables eviction.
+    // Current and peak figures are in renderStats.
+    Q_INVOKABLE void setMemoryBudget(int megabytes);
+
+    // Read a frame back without blocking the render thread. The image of
+    // the next rendered frame arrives through frameGrabbed() a frame or two
+    // later; an empty size grabs at the item's pixel size, other sizes render
+    // the view offscreen at that resolution. Returns the request number.
+    Q_INVOKABLE int grabAsync(const QSize &size = QSize());
+
+    // Trace spans, see OccTrace. The dump is Chrome trace JSON.
+    Q_INVOKABLE void setTracingEnabled(bool enabled);
+    Q_INVOKABLE bool writeTrace(const QString &path);
+
     // for test
     Q_INVOKABLE void addTestShape();
     Q_INVOKABLE void removeTestShape();
     Q_INVOKABLE void updateTestShape();
+    Q_INVOKABLE void addTestShapes(int count);
+
+    // Scene mutations recorded on the GUI thread, drained by the renderer
+    OccCommandQueue &commandQueue()
+    {
+        return command_queue_;
+    }
+    // Pointer input coalesced until the next synchronize()
+    OccInputQueue &inputQueue()
+    {
+        return input_queue_;
+    }
+    // One frame ms from now, a later call restarts the wait. GUI thread.
+    void updateAfter(int ms);
 
 protected:
-    OccSceneManager *getSceneManager() const;
+    void enqueue(OccSceneCommand command);
+    void emitShapeIdChanges();
+    void onShapeReady(const QString &id);
+    void addImportedShapes(const std::vector<OccShapeDesc> &shapes, bool fit);
+    void pushInput(const OccInputEvent &event);
 
     void mousePressEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
@@ -64,14 +242,73 @@ protected:
     void wheelEvent(QWheelEvent *event) override;
     void hoverMoveEvent(QHoverEvent *event) override;
 
+    QSGNode *updatePaintNode(QSGNode *node, UpdatePaintNodeData *data) override;
+    void releaseResources() override;
+    // underlay renderer, render thread with the GL context current
+    void renderUnderlay(QQuickWindow *win);
+    void releaseUnderlay();
+    // from the GUI thread, deletes the underlay renderer on the render thread
+    void scheduleUnderlayRelease();
+
 Q_SIGNALS:
     void windowVisibleChanged();
+    void lodPixelErrorChanged();
+    void resolutionSettingsChanged();
+    // Shape added with background tessellation is displayed
+    void shapeReady(const QString &id);
+    // Background meshing or a mesh update failed, the shape is not shown
+    // or keeps its previous vertices
+    void shapeFailed(const QString &id, const QString &error);
+    // Ids added and removed since the last notification, emitted once per
+    // event loop pass. After reset all previously known ids are gone.
+    void shapeIdsChanged(const QStringList &added, const QStringList &removed, bool reset);
+    void assemblyImported(const QString &path, bool ok, int instances, int parts);
+    void importStateChanged();
+    void importFinished(const QString &path, bool ok, bool cancelled, int shapes);
+    void loadProgress(int done, int total);
+    void filesLoaded(int files, int failed, double ms);
+    void meshFileSaved(const QString &path, bool ok);
+    void underlayChanged();
+    // latencyMs runs from the readback start to its delivery
+    void frameGrabbed(int request, const QImage &image, double latencyMs);
 
 private:
     bool visible_;
     QPoint last_mouse_pos_;
+    double lod_pixel_error_ = 1.0;
+    OccResolutionSettings resolution_;
+    OccRenderStats *render_stats_ = nullptr;
+    // single shot, see updateAfter()
+    QTimer *update_timer_ = nullptr;
+
+    OccCommandQueue command_queue_;
+    OccInputQueue input_queue_;
+    // thread-safe, shared with the scene manager
+    std::shared_ptr<OccMeshCache> mesh_cache_;
+    // GUI side view of the scene ids, the scene manager is render thread only
+    OccIdRegistry shape_ids_;
+    bool id_changes_queued_ = false;
+    int next_grab_ = 0;
+    // XDE import, one at a time
+    QThreadPool import_pool_;
+
+    bool importing_ = false;
+    double import_progress_ = 0.0;
+    double first_geometry_ms_ = -1.0;
+    QString import_prefix_;
+    QElapsedTimer import_timer_;
+    std::shared_ptr<std::atomic_bool> import_cancel_;
+    OccFileLoader *file_loader_ = nullptr;
 
     mutable OCCRenderer *renderer_ = nullptr;
+
+    bool underlay_ = false;
+    // owned by the item in underlay mode, created and used on the render thread
+    OCCRenderer *underlay_renderer_ = nullptr;
+    // window pixels, written in updatePaintNode() while the GUI is blocked
+    QSize underlay_size_;
+    std::atomic_bool underlay_visible_{true};
+    std::vector<QMetaObject::Connection> underlay_connections_;
 };
 } // namespace geotoys
 
@@ -0,0 +1,166 @@
+#include "OccXdeImporter.h"
+
+#include <map>
+#include <set>
+
+#include <IFSelect_ReturnStatus.hxx>
+#include <STEPCAFControl_Reader.hxx>
+#include <TCollection_AsciiString.hxx>
+#include <TDF_Label.hxx>
+#include <TDF_LabelSequence.hxx>
+#include <TDF_Tool.hxx>
+#include <TDataStd_Name.hxx>
+#include <TDocStd_Document.hxx>
+#include <XCAFApp_Application.hxx>
+#include <XCAFDoc_ColorTool.hxx>
+#include <XCAFDoc_DocumentTool.hxx>
+#include <XCAFDoc_ShapeTool.hxx>
+
+namespace geotoys
+{
+
+namespace
+{
+class AssemblyWalker
+{
+public:
+    AssemblyWalker(const Handle(TDocStd_Document) & doc, const std::string &id_prefix,
+                   OccXdeAssembly &assembly)
+        : shape_tool_(XCAFDoc_DocumentTool::ShapeTool(doc->Main()))
+        , color_tool_(XCAFDoc_DocumentTool::ColorTool(doc->Main()))
+        , id_prefix_(id_prefix)
+        , assembly_(assembly)
+    {
+    }
+
+    void walk()
+    {
+        TDF_LabelSequence roots;
+        shape_tool_->GetFreeShapes(roots);
+        for (const TDF_Label &root : roots)
+        {
+            visit(root, TopLoc_Location(), id_prefix_, Quantity_NOC_YELLOW);
+        }
+    }
+
+private:
+    void visit(const TDF_Label &label, const TopLoc_Location &parentLocation,
+               const std::string &parentPath, Quantity_Color color)
+    {
+        TDF_Label referred = label;
+        TopLoc_Location location = parentLocation;
+        if (XCAFDoc_ShapeTool::IsReference(label))
+        {
+            XCAFDoc_ShapeTool::GetReferredShape(label, referred);
+            location = parentLocation * XCAFDoc_ShapeTool::GetLocation(label);
+        }
+
+        // instance color wins over the part color, both over the parent one
+        if (!findColor(label, color))
+        {
+            findColor(referred, color);
+        }
+        const std::string path = parentPath + "/" + labelName(label, referred);
+
+        if (XCAFDoc_ShapeTool::IsAssembly(referred))
+        {
+            TDF_LabelSequence components;
+            XCAFDoc_ShapeTool::GetComponents(referred, components);
+            for (const TDF_Label &component : components)
+            {
+                visit(component, location, path, color);
+            }
+            return;
+        }
+
+        const TopoDS_Shape shape = XCAFDoc_ShapeTool::GetShape(referred);
+        if (shape.IsNull())
+        {
+            return;
+        }
+
+        TCollection_AsciiString entry;
+        TDF_Tool::Entry(referred, entry);
+        const std::string key = id_prefix_ + "#" + entry.ToCString();
+        if (prototype_keys_.insert(key).second)
+        {
+            OccXdePrototype prototype;
+            prototype.key = key;
+            prototype.shape = shape.Located(TopLoc_Location());
+            Quantity_Color partColor = Quantity_NOC_YELLOW;
+            findColor(referred, partColor);
+            prototype.color = partColor;
+            assembly_.prototypes.push_back(std::move(prototype));
+        }
+
+        OccXdeInstance instance;
+        instance.id = uniqueId(path);
+        instance.prototype = key;
+        instance.location = location * shape.Location();
+        instance.color = color;
+        assembly_.instances.push_back(std::move(instance));
+    }
+
+    bool findColor(const TDF_Label &label, Quantity_Color &color) const
+    {
+        return color_tool_->GetColor(label, XCAFDoc_ColorSurf, color) ||
+               color_tool_->GetColor(label, XCAFDoc_ColorGen, color);
+    }
+
+    static std::string labelName(const TDF_Label &label, const TDF_Label &referred)
+    {
+        Handle(TDataStd_Name) name;
+        if ((label.FindAttribute(TDataStd_Name::GetID(), name) ||
+             referred.FindAttribute(TDataStd_Name::GetID(), name)) &&
+            !name->Get().IsEmpty())
+        {
+            return TCollection_AsciiString(name->Get()).ToCString();
+        }
+        TCollection_AsciiString entry;
+        TDF_Tool::Entry(label, entry);
+        return entry.ToCString();
+    }
+
+    // names repeat for parts used several times in the same sub-assembly
+    std::string uniqueId(const std::string &path)
+    {
+        const int count = id_counts_[path]++;
+        return count == 0 ? path : path + ":" + std::to_string(count);
+    }
+
+private:
+    Handle(XCAFDoc_ShapeTool) shape_tool_;
+    Handle(XCAFDoc_ColorTool) color_tool_;
+    std::string id_prefix_;
+    OccXdeAssembly &assembly_;
+    std::set<std::string> prototype_keys_;
+    std::map<std::string, int> id_counts_;
+};
+} // namespace
+
+bool OccXdeImporter::readStep(const std::string &path, const std::string &id_prefix,
+                              OccXdeAssembly &assembly, std::string *error)
+{
+    Handle(XCAFApp_Application) app = XCAFApp_Application::GetApplication();
+    Handle(TDocStd_Document) doc;
+    app->NewDocument("MDTV-XCAF", doc);
+
+    STEPCAFControl_Reader reader;
+    reader.SetColorMode(true);
+    reader.SetNameMode(true);
+    if (reader.ReadFile(path.c_str()) != IFSelect_RetDone || !reader.Transfer(doc))
+    {
+        if (error)
+        {
+            *error = "cannot read STEP file " + path;
+        }
+        app->Close(doc);
+        return false;
+    }
+
+    AssemblyWalker(doc, id_prefix, assembly).walk();
+    app->Close(doc);
+    return true;
+}
+
+} // namespace geotoys
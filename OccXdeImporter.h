@@ -0,0 +1,54 @@
+#ifndef OCCXDEIMPORTER_H
+#define OCCXDEIMPORTER_H
+
+#include <string>
+#include <vector>
+
+#include <Quantity_Color.hxx>
+#include <TopLoc_Location.hxx>
+#include <TopoDS_Shape.hxx>
+
+namespace geotoys
+{
+
+// Unique part of an assembly, shared by all its instances
+struct OccXdePrototype
+{
+    std::string key;
+    // without location, placed by the instances
+    TopoDS_Shape shape;
+    Quantity_Color color = Quantity_NOC_YELLOW;
+};
+
+struct OccXdeInstance
+{
+    // assembly path of names, e.g. "prefix/root/sub1/bolt", unique per import
+    std::string id;
+    std::string prototype;
+    TopLoc_Location location;
+    Quantity_Color color = Quantity_NOC_YELLOW;
+};
+
+struct OccXdeAssembly
+{
+    std::vector<OccXdePrototype> prototypes;
+    std::vector<OccXdeInstance> instances;
+};
+
+// Reads STEP files through XDE (STEPCAFControl_Reader) and keeps the
+// assembly structure: every part is a prototype, every occurrence of the
+// part in the assembly tree an instance with its accumulated location and
+// color. May run on a worker thread, but not concurrently with another
+// import since the XCAF application is a process wide singleton.
+class OccXdeImporter
+{
+public:
+    // Instance ids are prefixed with id_prefix followed by '/', prototype keys
+    // are unique per id_prefix
+    static bool readStep(const std::string &path, const std::string &id_prefix,
+                         OccXdeAssembly &assembly, std::string *error = nullptr);
+};
+
+} // namespace geotoys
+
+#endif // OCCXDEIMPORTER_H
@@ -9,6 +9,7 @@
 #include <QQuickView>
 #include <QQuickWindow>
 
+#include "OccTrace.h"
 #include "OccViewerItem.h"
 
 int main(int argc, char *argv[])
@@ -20,8 +21,11 @@ int main(int argc, char *argv[])
     qputenv("QT_QPA_PLATFORM", "cocoa");
 #else
     // wayland-egl, minimal, xcb, vnc, linuxfb, eglfs, minimalegl, offscreen,
-    // wayland, vkkhrdisplay.
-    qputenv("QT_QPA_PLATFORM", "xcb");
+    // wayland, vkkhrdisplay. An explicitly chosen platform is kept.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "xcb");
+    }
 
     // WSL2-specific workarounds
     const char *wslEnv = getenv("WSL_DISTRO_NAME");
@@ -59,9 +63,12 @@ int main(int argc, char *argv[])
 
     QQuickWindow::setGraphicsApi(QSGRendererInterface::OpenGL);
     QGuiApplication app(argc, argv);
+    const std::string tracePath = geotoys::OccTrace::initFromEnvironment();
 
     // register custom QML type
     qmlRegisterType<geotoys::OccViewerItem>("OcctQML", 1, 0, "OccViewerItem");
+    qmlRegisterUncreatableType<geotoys::OccRenderStats>(
+        "OcctQML", 1, 0, "OccRenderStats", "OccRenderStats is provided by OccViewerItem");
 
     // use QQuickView to create window and load QML
     QQuickView view;
@@ -82,5 +89,10 @@ int main(int argc, char *argv[])
         return -1;
     }
 
-    return app.exec();
+    const int result = app.exec();
+    if (!tracePath.empty())
+    {
+        geotoys::OccTrace::writeChromeTrace(tracePath);
+    }
+    return result;
 }
@@ -170,6 +170,13 @@ Rectangle {
                                 Material.background: Material.color(Material.Blue)
                                 onClicked: occViewer.updateTestShape()
                             }
+                            Button {
+                                Layout.fillWidth: true
+                                Layout.preferredHeight: 35
+                                text: "Add 1000 Boxes"
+                                Material.background: Material.color(Material.Teal)
+                                onClicked: occViewer.addTestShapes(1000)
+                            }
                         }
 
                         // Status display
@@ -190,6 +197,20 @@ Rectangle {
                             }
                         }
 
+                        // Frame statistics
+                        Text {
+                            Layout.fillWidth: true
+                            readonly property var stats: occViewer.renderStats
+                            text: "Render " + stats.renderMs.toFixed(2) + " ms (max " + stats.renderMsMax.toFixed(2) + ")\n"
+                                  + "Sync " + stats.synchronizeMs.toFixed(2) + " ms, FBO " + stats.fboMs.toFixed(2) + " ms\n"
+                                  + "Flush " + stats.flushMs.toFixed(2) + " ms\n"
+                                  + "Triangles " + stats.triangles + ", elements " + stats.elements + "\n"
+                                  + "Frames " + stats.framesRendered + ", skipped " + stats.framesSkipped + "\n"
+                                  + "Selection pending " + stats.selectionPending + ", lag " + stats.selectionLagMs.toFixed(1) + " ms"
+                            font.pixelSize: 10
+                            color: Material.secondaryTextColor
+                        }
+
                         // Fill remaining space
                         Item {
                             Layout.fillHeight: true
@@ -229,10 +250,13 @@ Rectangle {
                         anchors.fill: parent
                         anchors.margins: 4  // Leave space for border
 
-                        // Optimize rendering settings
-                        layer.enabled: true
-                        layer.smooth: true
-                        layer.mipmap: true
+                        // Lower the render resolution while orbiting heavy models
+                        adaptiveResolution: true
+                        targetFrameTime: 16
+
+                        // No layer: the FBO texture is composited directly, an
+                        // extra layer would add a full screen copy per frame.
+                        // For a window filling viewer see the underlay property.
 
                         // Add initialization status indicator
                         Rectangle {